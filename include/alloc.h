@@ -0,0 +1,44 @@
+//  Copyright (c) 2015 Jakub Filipowicz <jakubf@gmail.com>
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc.,
+//  51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+
+
+#ifndef EMUI_ALLOC_H
+#define EMUI_ALLOC_H
+
+#include <stddef.h>
+
+// slab: fixed-size objects, carved from blocks of SLAB_BLOCK_OBJS
+struct emui_slab;
+typedef struct emui_slab EMSLAB;
+
+EMSLAB * emslab(size_t size);
+void emslab_delete(EMSLAB *s);
+void * emslab_alloc(EMSLAB *s);
+void emslab_free(EMSLAB *s, void *ptr);
+
+// arena: bump allocator, everything is released at once with emarena_delete()
+struct emui_arena;
+typedef struct emui_arena EMARENA;
+
+EMARENA * emarena(size_t chunk_size);
+void emarena_delete(EMARENA *a);
+void * emarena_alloc(EMARENA *a, size_t size);
+char * emarena_strdup(EMARENA *a, const char *str);
+
+#endif
+
+// vim: tabstop=4 shiftwidth=4 autoindent
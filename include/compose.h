@@ -0,0 +1,35 @@
+//  Copyright (c) 2015 Jakub Filipowicz <jakubf@gmail.com>
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc.,
+//  51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+
+
+#ifndef EMUI_COMPOSE_H
+#define EMUI_COMPOSE_H
+
+#include "tile.h"
+
+int emui_compose_layer(EMTILE *t, int parent_layer);
+void emui_compose_track(EMTILE *t);
+void emui_compose_forget(EMTILE *t);
+void emui_compose_begin();
+int emui_compose_tile(EMTILE *t, int layer);
+int emui_compose_defer(EMTILE *t, int layer, int touch);
+int emui_compose_next(EMTILE **t, int *layer, int *touch);
+void emui_compose_destroy();
+
+#endif
+
+// vim: tabstop=4 shiftwidth=4 autoindent
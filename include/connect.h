@@ -0,0 +1,39 @@
+//  Copyright (c) 2015 Jakub Filipowicz <jakubf@gmail.com>
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc.,
+//  51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+
+
+#ifndef EMUI_CONNECT_H
+#define EMUI_CONNECT_H
+
+#include <limits.h>
+
+#include "tile.h"
+#include "event.h"
+
+#define EV_ANY_SENDER INT_MIN
+
+int emui_connect(EMTILE *scope, int type, int sender, emui_int_f_ev handler);
+int emui_disconnect(EMTILE *scope, int type, int sender);
+void emui_disconnect_all(EMTILE *scope);
+int emui_connection_run(EMTILE *t, struct emui_event *ev);
+int emui_dispatch(struct emui_event *ev);
+void emui_dispatch_invalidate();
+void emui_connections_destroy();
+
+#endif
+
+// vim: tabstop=4 shiftwidth=4 autoindent
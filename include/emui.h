@@ -18,7 +18,10 @@
 #ifndef EMUI_H
 #define EMUI_H
 
+#include "connect.h"
 #include "focus.h"
+#include "keymap.h"
+#include "layout.h"
 #include "print.h"
 #include "style.h"
 #include "tiles.h"
@@ -26,6 +29,9 @@
 void emui_destroy();
 EMTILE * emui_init(unsigned fps);
 void emui_loop();
+void emui_batch_begin();
+void emui_batch_commit();
+void emui_layout_threads(int threads);
 
 EMTILE * emui_get_layout();
 unsigned emui_get_target_fps();
@@ -23,18 +23,44 @@ enum event_types {
 	EV_KEY,			// key pressed
 	EV_MOUSE,		// mouse event
 	EV_ERROR,		// error
+	EV_RESIZE,		// layout needs to be refitted to the terminal
+	EV_PASTE,		// text pasted (data: pasted text, sender: its length)
+	EV_USER,		// first event type available for the application
+};
+
+enum event_priorities {
+	EP_CONTROL,		// quit, errors, urgent application control (e.g. stop CPU)
+	EP_RESIZE,		// terminal resize
+	EP_INPUT,		// user input (keyboard, mouse)
+	EP_NOTIFY,		// application notifications
+	EP_BACKGROUND,	// background work
+	EP_COUNT
+};
+
+enum mouse_buttons {
+	MB_LEFT,		// left button pressed
+	MB_MIDDLE,		// middle button pressed
+	MB_RIGHT,		// right button pressed
+	MB_RELEASE,		// button released
+	MB_WHEEL_UP,	// wheel scrolled up
+	MB_WHEEL_DOWN,	// wheel scrolled down
+	MB_MOTION,		// pointer moved with a button pressed
 };
 
 struct emui_event {
 	int type;		// event type
-	int sender;		// event sender (key, error)
-	int x, y;
+	int sender;		// event sender (key, mouse button, error)
+	int x, y;		// pointer position (mouse events)
+	char *data;		// event data, freed together with the event
 };
 
 struct emui_event * emui_evq_get();
 int emui_evq_prepend(struct emui_event *ev);
 int emui_evq_append(struct emui_event *ev);
+int emui_evq_prepend_prio(struct emui_event *ev, int prio);
+int emui_evq_append_prio(struct emui_event *ev, int prio);
 void emui_evq_clear();
+void emui_event_free(struct emui_event *ev);
 
 #endif
 
@@ -36,9 +36,13 @@ int emui_has_focus(EMTILE *t);
 int emui_is_focused(EMTILE *t);
 EMTILE * emui_subfocus_get(EMTILE *t);
 EMTILE * emui_focus_get();
+unsigned long emui_focus_epoch_get();
 int emui_focus_group_add(EMTILE *parent, EMTILE *t);
 void emui_focus_group_unlink(EMTILE *t);
-void emui_focus_stack_delete_tile(EMTILE *t);
+int emui_focus_key_set(EMTILE *t, int key);
+EMTILE * emui_focus_key_get(EMTILE *fg, int key);
+void emui_focus_keys_drop(EMTILE *fg);
+void emui_focus_stack_purge();
 void emui_focus_stack_drop();
 void emui_focus_refocus();
 
@@ -0,0 +1,31 @@
+//  Copyright (c) 2015 Jakub Filipowicz <jakubf@gmail.com>
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc.,
+//  51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+
+#ifndef EMUI_HITMAP_H
+#define EMUI_HITMAP_H
+
+#include "tile.h"
+
+int emui_hitmap_resize(EMTILE *root, int w, int h);
+void emui_hitmap_update(EMTILE *t);
+void emui_hitmap_remove(EMTILE *t);
+EMTILE * emui_hitmap_get(int x, int y);
+void emui_hitmap_destroy();
+
+#endif
+
+// vim: tabstop=4 shiftwidth=4 autoindent
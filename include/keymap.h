@@ -0,0 +1,46 @@
+//  Copyright (c) 2015 Jakub Filipowicz <jakubf@gmail.com>
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc.,
+//  51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+
+
+#ifndef EMUI_KEYMAP_H
+#define EMUI_KEYMAP_H
+
+#include "tile.h"
+
+struct emui_keybinding {
+	char *keys;				// key sequence, e.g. "g g", "C-PgUp", "Up"
+	emui_int_f_int handler;	// handler called when the sequence is complete
+	int arg;				// argument passed to the handler
+};
+
+struct emui_keymap;
+typedef struct emui_keymap EMKEYMAP;
+
+EMKEYMAP * emkeymap();
+void emkeymap_delete(EMKEYMAP *km);
+int emkeymap_bind(EMKEYMAP *km, char *keys, emui_int_f_int handler, int arg);
+int emkeymap_load(EMKEYMAP *km, struct emui_keybinding *kb);
+void emkeymap_reset(EMKEYMAP *km);
+void emkeymap_reset_pending();
+int emkeymap_feed(EMKEYMAP *km, EMTILE *t, int key);
+int emui_key_code(char *name);
+
+void emtile_set_keymap(EMTILE *t, EMKEYMAP *km);
+
+#endif
+
+// vim: tabstop=4 shiftwidth=4 autoindent
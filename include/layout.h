@@ -0,0 +1,37 @@
+//  Copyright (c) 2015 Jakub Filipowicz <jakubf@gmail.com>
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc.,
+//  51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+
+
+#ifndef EMUI_LAYOUT_H
+#define EMUI_LAYOUT_H
+
+#include "tile.h"
+
+struct emui_template;
+typedef struct emui_template EMTPL;
+typedef void (*emui_template_bind_f)(EMTILE *t, EMTILE **slots, int idx, void *ptr);
+
+int emui_layout_compile(char *src, char *dst, int *err_line);
+EMTILE * emui_layout_load(EMTILE *parent, char *path);
+
+EMTPL * emui_template(char *text, int *err_line);
+void emui_template_delete(EMTPL *tpl);
+int emui_template_instantiate(EMTPL *tpl, EMTILE *parent, int count, emui_template_bind_f bind, void *ptr);
+
+#endif
+
+// vim: tabstop=4 shiftwidth=4 autoindent
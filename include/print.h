@@ -29,6 +29,7 @@ int vemuiprt(EMTILE *t, int style, char *format, va_list vl);
 int vemuixyprt(EMTILE *t, unsigned x, unsigned y, int style, char *format, va_list vl);
 
 int emuibox(EMTILE *t, int style);
+int emuibgchanged(EMTILE *t, int style);
 int emuifillbg(EMTILE *t, int style);
 int emuihline(EMTILE *t, int x, int y, int len, int style);
 int emuivline(EMTILE *t, int x, int y, int len, int style);
@@ -54,6 +54,12 @@ enum emui_align_types {
 	AL_VERTICAL,
 };
 
+enum emui_layers {
+	Z_BASE = 0,		// regular tiles
+	Z_FLOAT,		// floating focus groups
+	Z_DIALOG,		// dialogs, popups
+};
+
 enum emui_geometries {
 	GEOM_INTERNAL,
 	GEOM_EXTERNAL
@@ -62,6 +68,9 @@ enum emui_geometries {
 enum emui_return_codes {
 	E_OK = 0,
 	E_ALLOC,
+	E_SYNTAX,
+	E_CONFLICT,
+	E_IO,
 };
 
 enum emui_handler_results {
@@ -100,12 +109,20 @@ enum emui_tile_properties {
 	P_INTERACTIVE	= 1 << 18,	// user can interact with the tile (thus it can be focused)
 	P_NOCANVAS		= 1 << 19,	// tile has no canvas to draw on
 	P_CONTAINER		= 1 << 20,	// other tiles can be placed within this tile
-	P_DELETED		= 1 << 21,	// delete the tile with next emui_draw()
+	P_DELETED		= 1 << 21,	// tile is queued for deletion (deleted before next frame)
+	P_SHARED_CANVAS	= 1 << 22,	// tile draws into ancestor's window instead of its own
+	P_LAYOUT_STATE	= 1 << 23,	// children layout depends on container state other than geometry
+	P_LAYOUT_SERIAL	= 1 << 24,	// children layout has side effects, container is never laid out in parallel
 };
 
 #define P_APP_SETTABLE 0xffff
 
 struct emui_event;
+struct emui_keymap;
+struct emui_connection;
+struct emui_arena;
+struct emui_fgindex;
+struct emui_fgkeys;
 struct emui_tile;
 typedef struct emui_tile EMTILE;
 
@@ -115,6 +132,7 @@ typedef int (*emui_int_f_ev)(EMTILE *t, struct emui_event *ev);
 typedef int (*emui_int_f_int)(EMTILE *t, int arg);
 typedef void (*emui_void_f_int)(EMTILE *t, int arg);
 typedef void (*emui_void_f_emtile)(EMTILE *t, EMTILE *f);
+typedef EMTILE ** (*emui_children_f)(EMTILE *t, int *count);
 
 struct emtile_drv {
 	emui_void_f draw;
@@ -122,12 +140,41 @@ struct emtile_drv {
 	emui_int_f_ev event_handler;
 	emui_void_f destroy_priv_data;
 	emui_void_f_emtile scroll_handler;
+	emui_void_f_emtile child_removed;
+	int pure_geometry;			// update_children_geometry touches only the subtree
+	emui_children_f visited_children;	// children that need to be drawn and laid out (NULL: all)
 };
 
 struct emui_geom {
 	int x, y, w, h;
 };
 
+// iterator over children visited when drawing and laying out a tile
+struct emtile_visit {
+	EMTILE **tiles;				// children listed by the driver (NULL: all of them)
+	int count;
+	int pos;
+	EMTILE *next;
+};
+
+// size constraints used by flex containers to lay out their children
+struct emui_flex_hint {
+	int set;					// hint has been set (otherwise requested size is kept)
+	int min, max;				// size limits (max: 0 = none, <0 = fraction of space as in FIT_DIV*)
+	int weight;					// share of the remaining space
+	int priority;				// children with lower priority are hidden first
+};
+
+// everything tile geometry depends on (as of the last fit)
+struct emui_fit_inputs {
+	struct emui_geom pg;		// geometry parent's area
+	struct emui_geom r;			// app-requested geometry
+	struct emui_geom e;			// external area (set by parent for forced geometry)
+	unsigned mt, mb, ml, mr;	// margins
+	unsigned properties;		// tile properties
+	unsigned parent_properties;	// parent properties
+};
+
 struct emui_tile {
 	// general
 	int __dbg_id;				// for debugging purposes
@@ -146,17 +193,32 @@ struct emui_tile {
 	struct emui_geom r;			// app-requested tile geometry (parent relative)
 	struct emui_geom e;			// actual external tile area
 	struct emui_geom i;			// actual internal tile area (d* minus m*)
+	struct emui_fit_inputs fi;	// layout inputs used by the last fit
+	struct emui_geom hm;		// area the tile is registered with in the hit map
+	int hm_indexed;				// tile is registered in the hit map
+	unsigned long draw_seq;		// drawing order (tiles drawn later are on top)
+	int layer;					// z-layer requested for the tile and its subtree
+	int occluded;				// tile is completely covered by a higher layer
+	int tt_idx;					// row in the tile table
+	struct emui_flex_hint fx;	// layout constraints (when in a flex container)
+	int list_row;				// row number (when in a list container)
 
 	// ncurses data
 	WINDOW *ncwin;				// ncurses window
+	WINDOW *canvas;				// shared window the tile is being drawn into (P_SHARED_CANVAS)
+	int erased;					// window has been cleared since the tile was last drawn
+	int cv_x, cv_y;				// tile position within the shared window
+	int cur_x, cur_y;			// drawing position within the tile (shared window)
 
 	// UI hierarchical structure
 	EMTILE *parent;		// parent tile
+	int depth;			// number of ancestors
 	EMTILE *ch_first;	// children list start
 	EMTILE *ch_last;	// children list end
 	EMTILE *ch_next;	// next tile in child list
 	EMTILE *ch_prev;	// previous tile in child list
 	EMTILE *focus;		// next tile in focus chain
+	unsigned long focus_epoch;	// tile is on the focus path if it matches the current focus epoch
 
 	// focus group structure
 	EMTILE *fg;			// tile's focus group
@@ -164,46 +226,81 @@ struct emui_tile {
 	EMTILE *fg_last;	// focus group end
 	EMTILE *fg_next;	// next tile in focus group list
 	EMTILE *fg_prev;	// previous tile in focus group list
+	struct emui_fgindex *fg_index;	// spatial index of focus group members
+	int fg_ord;			// position in the focus group list (as of last indexing)
+	struct emui_fgkeys *fg_keys;	// focus keys of focus group members
+
+	// path index
+	unsigned path_hash;	// hash of the tile's path
+	EMTILE *path_group;	// next group of tiles in path index bucket (group heads only)
+	EMTILE *path_next;	// next tile with the same path hash
+	EMTILE *path_prev;	// previous tile with the same path hash (last one for the group head)
 
 	// tile-specific data and methods
 	void *priv_data;
+	size_t priv_size;			// size of priv_data allocated with emtile_priv_alloc()
 	struct emtile_drv *drv;
 
+	// memory
+	struct emui_arena *arena;			// arena tile is allocated from (NULL = slabs)
+	struct emui_arena *subtree_arena;	// arena owned by the tile, used by its descendants
+
 	// app-provided data and handlers
 	void *ptr;
 	emui_int_f update_handler;
 	emui_int_f change_handler;
 	emui_int_f_int key_handler;
+	struct emui_keymap *keymap;	// app key bindings (run before key_handler)
+	struct emui_connection *connections;	// handlers connected with emui_connect()
 };
 
 EMTILE * emtile(EMTILE *parent, struct emtile_drv *drv, int x, int y, int w, int h, int mt, int mb, int ml, int mr, char *name, int properties);
 void emtile_delete(EMTILE *t);
 void _emtile_really_delete(EMTILE *t);
-
-void emtile_fit(EMTILE *t);
+int emtile_delete_queued();
+EMTILE * _emtile_alloc(EMTILE *parent);
+int _emtile_defer_fit(int defer);
+void _emtile_allocators_destroy();
+
+void * emtile_priv_alloc(EMTILE *t, size_t size);
+void emtile_priv_free(EMTILE *t);
+int emtile_set_arena(EMTILE *t, size_t chunk_size);
+
+int emtile_fit(EMTILE *t);
+void _emtile_fit_geometry(EMTILE *t);
+int _emtile_fit_finish(EMTILE *t, struct emui_geom *old_i);
+int emtile_fit_needed(EMTILE *t);
+EMTILE * _emtile_visit_first(EMTILE *t, struct emtile_visit *v);
+EMTILE * _emtile_visit_next(struct emtile_visit *v);
+int _emtile_restore_geometry(EMTILE *t, struct emui_geom *e, struct emui_geom *i, struct emui_fit_inputs *fi);
 void emtile_draw(EMTILE *t);
+void _emtile_place_cursor(EMTILE *t);
 int emtile_event(EMTILE *t, struct emui_event *ev);
+int emtile_event_handlers(EMTILE *t, struct emui_event *ev);
 
 void emtile_set_update_handler(EMTILE *t, emui_int_f handler);
 void emtile_set_change_handler(EMTILE *t, emui_int_f handler);
 void emtile_set_key_handler(EMTILE *t, emui_int_f_int handler);
 
-void emtile_set_focus_key(EMTILE *t, int key);
+int emtile_set_focus_key(EMTILE *t, int key);
 int emtile_set_properties(EMTILE *t, unsigned properties);
 int emtile_clear_properties(EMTILE *t, unsigned properties);
 int emtile_set_name(EMTILE *t, char *name);
+EMTILE * emtile_find(char *path);
 void emtile_set_style(EMTILE *t, int style);
 void emtile_set_ptr(EMTILE *t, void *ptr);
 void * emtile_get_ptr(EMTILE *t);
 void emtile_set_margins(EMTILE *t, int mt, int mb, int ml, int mr);
 void emtile_set_geometry_parent(EMTILE *t, EMTILE *pg, int geom_type);
 void emtile_set_float_parent(EMTILE *t, EMTILE *p);
+void emtile_set_layer(EMTILE *t, int layer);
 
 void emtile_geometry_changed(EMTILE *t);
 int emtile_notify_change(EMTILE *t);
 
 EMTILE *emtile_get_list_neighbour(EMTILE *t, int dir, unsigned prop_match, unsigned prop_nomatch);
 EMTILE *emtile_get_physical_neighbour(EMTILE *t, int dir, unsigned prop_match, unsigned prop_nomatch);
+EMTILE *emtile_get_physical_neighbour_from(EMTILE *fg, EMTILE *t, int dir, unsigned prop_match, unsigned prop_nomatch);
 
 #endif
 
@@ -26,14 +26,24 @@
 
 // containers
 
+typedef EMTILE * (*emui_vgrid_new_f)(EMTILE *vgrid);
+typedef void (*emui_vgrid_cell_f)(EMTILE *vgrid, EMTILE *cell, int row, int col);
+
 EMTILE * emui_screen();
 EMTILE * emui_dummy_cont(EMTILE *parent, int x, int y, int w, int h);
 EMTILE * emui_splitter(EMTILE *parent, int edge, int min1, int max1, int min2);
 EMTILE * emui_tabs(EMTILE *parent);
 EMTILE * emui_frame(EMTILE *parent, int x, int y, int w, int h, char *name, int properties);
 EMTILE * emui_justifier(EMTILE *parent);
+EMTILE * emui_flex(EMTILE *parent, int align);
+int emui_flex_hint(EMTILE *t, int min, int max, int weight, int priority);
 EMTILE * emui_grid(EMTILE *parent, int cols, int rows, int col_width, int row_height, int col_spacing);
 EMTILE * emui_list(EMTILE *parent);
+int emui_list_row_height(EMTILE *row, int h);
+EMTILE * emui_vgrid(EMTILE *parent, int rows, int cols, int col_width, int row_height, int col_spacing, emui_vgrid_new_f cell_new, emui_vgrid_cell_f cell);
+void emui_vgrid_set_size(EMTILE *t, int rows, int cols);
+void emui_vgrid_scroll_to(EMTILE *t, int row, int col);
+int emui_vgrid_get_pos(EMTILE *cell, int *row, int *col);
 
 #endif
 
@@ -0,0 +1,34 @@
+//  Copyright (c) 2015 Jakub Filipowicz <jakubf@gmail.com>
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc.,
+//  51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+
+
+#ifndef EMUI_TILETAB_H
+#define EMUI_TILETAB_H
+
+#include "tile.h"
+
+void emui_tiletab_invalidate();
+int emui_tiletab_sync(EMTILE *root);
+void emui_tiletab_update(EMTILE *t);
+int emui_tiletab_subtree_idle(EMTILE *t);
+int emui_tiletab_count();
+EMTILE * emui_tiletab_tile(int idx);
+void emui_tiletab_destroy();
+
+#endif
+
+// vim: tabstop=4 shiftwidth=4 autoindent
@@ -0,0 +1,206 @@
+//  Copyright (c) 2015 Jakub Filipowicz <jakubf@gmail.com>
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc.,
+//  51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "alloc.h"
+
+// Slabs hand out zeroed fixed-size objects from big blocks, freed objects
+// go to a free list and are reused first. Blocks are never returned
+// to the system before the slab itself is deleted.
+//
+// Arenas hand out memory by bumping a pointer within a chunk. Nothing
+// is freed separately, all chunks are released with the arena.
+
+#define ALLOC_ALIGN 16
+#define SLAB_BLOCK_OBJS 64
+#define ARENA_CHUNK_SIZE 16384
+
+#define ALIGN_UP(s) (((s) + ALLOC_ALIGN - 1) & ~((size_t) ALLOC_ALIGN - 1))
+
+struct slab_block {
+	struct slab_block *next;
+	// objects follow (header is padded to keep them aligned)
+};
+
+struct slab_obj {
+	struct slab_obj *next;
+};
+
+struct emui_slab {
+	size_t size;
+	struct slab_block *blocks;
+	struct slab_obj *free;
+};
+
+struct arena_chunk {
+	struct arena_chunk *next;
+	size_t size;
+	size_t used;
+};
+
+struct emui_arena {
+	size_t chunk_size;
+	struct arena_chunk *chunks;
+};
+
+#define SLAB_HDR_SIZE ALIGN_UP(sizeof(struct slab_block))
+#define ARENA_HDR_SIZE ALIGN_UP(sizeof(struct arena_chunk))
+
+// -----------------------------------------------------------------------
+EMSLAB * emslab(size_t size)
+{
+	EMSLAB *s = calloc(1, sizeof(EMSLAB));
+	if (!s) return NULL;
+
+	if (size < sizeof(struct slab_obj)) {
+		size = sizeof(struct slab_obj);
+	}
+	s->size = ALIGN_UP(size);
+
+	return s;
+}
+
+// -----------------------------------------------------------------------
+void emslab_delete(EMSLAB *s)
+{
+	if (!s) return;
+
+	struct slab_block *b = s->blocks;
+	while (b) {
+		struct slab_block *next = b->next;
+		free(b);
+		b = next;
+	}
+	free(s);
+}
+
+// -----------------------------------------------------------------------
+static int _slab_grow(EMSLAB *s)
+{
+	struct slab_block *b = malloc(SLAB_HDR_SIZE + SLAB_BLOCK_OBJS * s->size);
+	if (!b) return -1;
+
+	b->next = s->blocks;
+	s->blocks = b;
+
+	// thread new objects onto the free list, lowest address first
+	char *objs = (char *) b + SLAB_HDR_SIZE;
+	for (int i=SLAB_BLOCK_OBJS-1 ; i>=0 ; i--) {
+		struct slab_obj *o = (struct slab_obj *) (objs + i * s->size);
+		o->next = s->free;
+		s->free = o;
+	}
+
+	return 0;
+}
+
+// -----------------------------------------------------------------------
+void * emslab_alloc(EMSLAB *s)
+{
+	if (!s->free && _slab_grow(s)) {
+		return NULL;
+	}
+
+	struct slab_obj *o = s->free;
+	s->free = o->next;
+	memset(o, 0, s->size);
+
+	return o;
+}
+
+// -----------------------------------------------------------------------
+void emslab_free(EMSLAB *s, void *ptr)
+{
+	if (!ptr) return;
+
+	struct slab_obj *o = ptr;
+	o->next = s->free;
+	s->free = o;
+}
+
+// -----------------------------------------------------------------------
+EMARENA * emarena(size_t chunk_size)
+{
+	EMARENA *a = calloc(1, sizeof(EMARENA));
+	if (!a) return NULL;
+
+	a->chunk_size = chunk_size ? chunk_size : ARENA_CHUNK_SIZE;
+
+	return a;
+}
+
+// -----------------------------------------------------------------------
+void emarena_delete(EMARENA *a)
+{
+	if (!a) return;
+
+	struct arena_chunk *c = a->chunks;
+	while (c) {
+		struct arena_chunk *next = c->next;
+		free(c);
+		c = next;
+	}
+	free(a);
+}
+
+// -----------------------------------------------------------------------
+void * emarena_alloc(EMARENA *a, size_t size)
+{
+	struct arena_chunk *c = a->chunks;
+
+	size = ALIGN_UP(size ? size : 1);
+
+	if (!c || (c->used + size > c->size)) {
+		// oversized allocations get a chunk of their own
+		size_t csize = size > a->chunk_size ? size : a->chunk_size;
+		c = malloc(ARENA_HDR_SIZE + csize);
+		if (!c) return NULL;
+		c->size = csize;
+		c->used = 0;
+		// keep the partially used chunk in front if the new one is full already
+		if (a->chunks && (size == csize)) {
+			c->next = a->chunks->next;
+			a->chunks->next = c;
+		} else {
+			c->next = a->chunks;
+			a->chunks = c;
+		}
+	}
+
+	void *ptr = (char *) c + ARENA_HDR_SIZE + c->used;
+	c->used += size;
+	memset(ptr, 0, size);
+
+	return ptr;
+}
+
+// -----------------------------------------------------------------------
+char * emarena_strdup(EMARENA *a, const char *str)
+{
+	size_t len = strlen(str) + 1;
+	char *s = emarena_alloc(a, len);
+	if (!s) return NULL;
+
+	memcpy(s, str, len);
+
+	return s;
+}
+
+// vim: tabstop=4 shiftwidth=4 autoindent
@@ -0,0 +1,244 @@
+//  Copyright (c) 2015 Jakub Filipowicz <jakubf@gmail.com>
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc.,
+//  51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "dbg.h"
+#include "tile.h"
+#include "compose.h"
+
+// Compositor draws the tile tree in z-layers. A tile is drawn in its
+// parent's layer, unless it asks for a higher one (or is floating),
+// then the tile starts a new layer for its whole subtree. Subtrees
+// in higher layers are drawn after all lower layers.
+//
+// Tiles that start a layer and have a window of their own cover
+// what's below them. Lower layer tiles that are completely covered
+// are neither drawn nor copied to the screen - their windows keep
+// the last contents and are copied again once uncovered. Covering tile
+// that has a lower layer tile drawn underneath is copied as a whole.
+//
+// Covers are taken from the previous layout: tile (or any of its
+// ancestors) with pending geometry change doesn't cover anything
+// until it's laid out.
+
+struct cover {
+	EMTILE *t;
+	struct emui_geom g;
+	int layer;
+	int damaged;				// lower layer has been drawn underneath
+};
+
+struct deferred {
+	EMTILE *t;
+	int layer;
+	int touch;
+};
+
+static EMTILE **roots;			// tiles that start a layer
+static int roots_count, roots_size;
+
+static struct cover *covers;
+static int covers_count, covers_size;
+
+static struct deferred *pending;
+static int pending_count, pending_size;
+
+// -----------------------------------------------------------------------
+static int _grow(void **array, int *size, int count, size_t item_size)
+{
+	if (count < *size) return E_OK;
+
+	int nsize = *size ? *size * 2 : 8;
+	void *a = realloc(*array, nsize * item_size);
+	if (!a) return E_ALLOC;
+
+	*array = a;
+	*size = nsize;
+
+	return E_OK;
+}
+
+// -----------------------------------------------------------------------
+int emui_compose_layer(EMTILE *t, int parent_layer)
+{
+	int layer = t->layer > parent_layer ? t->layer : parent_layer;
+
+	if ((t->properties & P_FLOAT) && (layer < Z_FLOAT)) {
+		layer = Z_FLOAT;
+	}
+
+	return layer;
+}
+
+// -----------------------------------------------------------------------
+void emui_compose_forget(EMTILE *t)
+{
+	for (int i=0 ; i<roots_count ; i++) {
+		if (roots[i] == t) {
+			roots[i] = roots[--roots_count];
+			return;
+		}
+	}
+}
+
+// -----------------------------------------------------------------------
+void emui_compose_track(EMTILE *t)
+{
+	emui_compose_forget(t);
+
+	if ((t->layer > Z_BASE) || (t->properties & P_FLOAT)) {
+		if (_grow((void **) &roots, &roots_size, roots_count, sizeof(EMTILE *)) != E_OK) {
+			// tile is still drawn in its layer, just doesn't cover anything
+			return;
+		}
+		roots[roots_count++] = t;
+	}
+}
+
+// -----------------------------------------------------------------------
+static int _cover_layer(EMTILE *t)
+{
+	int layer = Z_BASE;
+
+	// layer is known only if the tile is laid out where it's going to be drawn
+	for (EMTILE *p=t ; p ; p=p->parent) {
+		if (p->geometry_changed) return -1;
+		if (p->layer > layer) layer = p->layer;
+		if ((p->properties & P_FLOAT) && (layer < Z_FLOAT)) layer = Z_FLOAT;
+	}
+
+	return layer;
+}
+
+// -----------------------------------------------------------------------
+void emui_compose_begin()
+{
+	covers_count = 0;
+	pending_count = 0;
+
+	for (int i=0 ; i<roots_count ; i++) {
+		EMTILE *t = roots[i];
+		if ((t->properties & (P_HIDDEN | P_NOCANVAS)) || !t->ncwin) {
+			continue;
+		}
+		int layer = _cover_layer(t);
+		if (layer <= Z_BASE) continue;
+		if (_grow((void **) &covers, &covers_size, covers_count, sizeof(struct cover)) != E_OK) {
+			break;
+		}
+		struct cover *c = covers + covers_count++;
+		c->t = t;
+		c->g = t->e;
+		c->layer = layer;
+		c->damaged = 0;
+	}
+}
+
+// -----------------------------------------------------------------------
+static int _contains(struct emui_geom *c, struct emui_geom *g)
+{
+	return (g->x >= c->x) && (g->y >= c->y) && (g->x + g->w <= c->x + c->w) && (g->y + g->h <= c->y + c->h);
+}
+
+// -----------------------------------------------------------------------
+static int _intersects(struct emui_geom *c, struct emui_geom *g)
+{
+	return (g->x < c->x + c->w) && (c->x < g->x + g->w) && (g->y < c->y + c->h) && (c->y < g->y + g->h);
+}
+
+// -----------------------------------------------------------------------
+int emui_compose_tile(EMTILE *t, int layer)
+{
+	for (int i=0 ; i<covers_count ; i++) {
+		if ((covers[i].layer > layer) && _contains(&covers[i].g, &t->e)) {
+			EDBG(t, 3, "tile is occluded by a higher layer");
+			return 1;
+		}
+	}
+
+	// tile is going to be drawn, higher layers above it need to be copied again
+	for (int i=0 ; i<covers_count ; i++) {
+		if ((covers[i].layer > layer) && _intersects(&covers[i].g, &t->e)) {
+			covers[i].damaged = 1;
+		}
+	}
+
+	return 0;
+}
+
+// -----------------------------------------------------------------------
+int emui_compose_defer(EMTILE *t, int layer, int touch)
+{
+	if (_grow((void **) &pending, &pending_size, pending_count, sizeof(struct deferred)) != E_OK) {
+		return E_ALLOC;
+	}
+
+	struct deferred *d = pending + pending_count++;
+	d->t = t;
+	d->layer = layer;
+	d->touch = touch;
+
+	return E_OK;
+}
+
+// -----------------------------------------------------------------------
+int emui_compose_next(EMTILE **t, int *layer, int *touch)
+{
+	if (!pending_count) return 0;
+
+	// lowest layer first, in the order subtrees were found
+	int n = 0;
+	for (int i=1 ; i<pending_count ; i++) {
+		if (pending[i].layer < pending[n].layer) {
+			n = i;
+		}
+	}
+
+	*t = pending[n].t;
+	*layer = pending[n].layer;
+	*touch = pending[n].touch;
+
+	pending_count--;
+	memmove(pending + n, pending + n + 1, (pending_count - n) * sizeof(struct deferred));
+
+	for (int i=0 ; i<covers_count ; i++) {
+		if ((covers[i].t == *t) && covers[i].damaged) {
+			*touch = 1;
+		}
+	}
+
+	return 1;
+}
+
+// -----------------------------------------------------------------------
+void emui_compose_destroy()
+{
+	free(roots);
+	free(covers);
+	free(pending);
+	roots = NULL;
+	covers = NULL;
+	pending = NULL;
+	roots_count = roots_size = 0;
+	covers_count = covers_size = 0;
+	pending_count = pending_size = 0;
+}
+
+// vim: tabstop=4 shiftwidth=4 autoindent
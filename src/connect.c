@@ -0,0 +1,477 @@
+//  Copyright (c) 2015 Jakub Filipowicz <jakubf@gmail.com>
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc.,
+//  51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+
+
+#include <stdlib.h>
+#include <stdint.h>
+
+#include "dbg.h"
+#include "tile.h"
+#include "event.h"
+#include "focus.h"
+#include "connect.h"
+
+// Handlers connected to tiles are kept in a single hash table
+// keyed by (scope tile, event type, event sender). Each scope also
+// lists its own connections, so tiles with nothing connected (most of them)
+// are skipped by emtile_event() without any lookup.
+//
+// For events dispatched along the focus path, connections of scopes on
+// the path are merged into one more table keyed by (event type, sender)
+// only. Scopes are merged outermost first: a connection of an inner scope
+// hides (and remembers) the one of an outer scope for the same event.
+// When focus moves, only scopes on the part of the path that changed
+// are taken out (innermost first, uncovering what they've hidden) and
+// merged in, so global shortcuts connected to the root are merged once.
+//
+// Tiles on the focus path that have their own handlers (key handler, keymap,
+// driver event handler, focus group) are listed too. Dispatching an event
+// costs two lookups, plus calling own handlers of tiles below the scope
+// that got the event connected. Tiles without any handlers are never visited.
+
+#define CTAB_MIN_SIZE 64
+
+struct emui_connection {
+	EMTILE *scope;
+	int type;
+	int sender;
+	emui_int_f_ev handler;
+	struct emui_connection *next;		// next in the connection table bucket
+	struct emui_connection *scope_next;	// next connection of the same scope
+	struct emui_connection *dnext;		// next in the dispatch table bucket
+	struct emui_connection *shadow;		// outer scope's connection hidden by this one
+};
+
+typedef struct emui_connection CONN;
+
+static CONN **ctab;
+static unsigned ctab_size;
+static unsigned ctab_count;
+
+static CONN **dtab;
+static unsigned dtab_size;
+
+// scopes merged into the dispatch table, outermost first
+static EMTILE **dscopes;
+static int dscopes_count;
+// tiles on the focus path with own handlers, innermost first
+static EMTILE **downers;
+static int downers_count;
+// scratch: scopes on the new focus path, innermost first
+static EMTILE **dpath;
+static int dpath_size;
+
+// dispatch table reflects this focus epoch and handler generation
+static unsigned long dtab_epoch;
+static unsigned long dtab_gen = 1;
+static unsigned long handler_gen;
+
+// -----------------------------------------------------------------------
+static unsigned _hash(EMTILE *scope, int type, int sender)
+{
+	uint32_t h = (uint32_t) ((uintptr_t) scope >> 4);
+	h ^= (uint32_t) type * 0x9e3779b1u;
+	h ^= (uint32_t) sender * 0x85ebca6bu;
+	h ^= h >> 16;
+	h *= 0x7feb352du;
+	h ^= h >> 15;
+	return h & (ctab_size - 1);
+}
+
+// -----------------------------------------------------------------------
+static CONN ** _find(EMTILE *scope, int type, int sender)
+{
+	CONN **c = ctab + _hash(scope, type, sender);
+
+	while (*c) {
+		if (((*c)->scope == scope) && ((*c)->type == type) && ((*c)->sender == sender)) {
+			break;
+		}
+		c = &(*c)->next;
+	}
+
+	return c;
+}
+
+// -----------------------------------------------------------------------
+static int _ctab_resize(unsigned size)
+{
+	CONN **ntab = calloc(size, sizeof(CONN *));
+	if (!ntab) return E_ALLOC;
+
+	CONN **otab = ctab;
+	unsigned osize = ctab_size;
+
+	ctab = ntab;
+	ctab_size = size;
+
+	// rehash all connections
+	for (unsigned i=0 ; i<osize ; i++) {
+		CONN *c = otab[i];
+		while (c) {
+			CONN *next = c->next;
+			unsigned h = _hash(c->scope, c->type, c->sender);
+			c->next = ctab[h];
+			ctab[h] = c;
+			c = next;
+		}
+	}
+
+	free(otab);
+
+	return E_OK;
+}
+
+// -----------------------------------------------------------------------
+int emui_connect(EMTILE *scope, int type, int sender, emui_int_f_ev handler)
+{
+	if (!scope || !handler) return -1;
+
+	if (!ctab && (_ctab_resize(CTAB_MIN_SIZE) != E_OK)) {
+		return E_ALLOC;
+	}
+
+	// connecting the same event again replaces the handler
+	CONN **c = _find(scope, type, sender);
+	if (*c) {
+		EDBG(scope, 3, "replacing handler for event %i:%i", type, sender);
+		(*c)->handler = handler;
+		return E_OK;
+	}
+
+	CONN *nc = malloc(sizeof(CONN));
+	if (!nc) return E_ALLOC;
+
+	nc->scope = scope;
+	nc->type = type;
+	nc->sender = sender;
+	nc->handler = handler;
+	nc->next = NULL;
+	*c = nc;
+
+	nc->scope_next = scope->connections;
+	scope->connections = nc;
+
+	ctab_count++;
+	handler_gen++;
+
+	// keep the load factor below 1
+	if (ctab_count > ctab_size) {
+		_ctab_resize(ctab_size * 2);
+	}
+
+	return E_OK;
+}
+
+// -----------------------------------------------------------------------
+static void _remove(CONN **c)
+{
+	CONN *dc = *c;
+	*c = dc->next;
+
+	CONN **sc = &dc->scope->connections;
+	while (*sc != dc) {
+		sc = &(*sc)->scope_next;
+	}
+	*sc = dc->scope_next;
+
+	free(dc);
+	ctab_count--;
+	handler_gen++;
+}
+
+// -----------------------------------------------------------------------
+int emui_disconnect(EMTILE *scope, int type, int sender)
+{
+	if (!ctab || !scope || !scope->connections) return -1;
+
+	CONN **c = _find(scope, type, sender);
+	if (!*c) return -1;
+
+	_remove(c);
+
+	return E_OK;
+}
+
+// -----------------------------------------------------------------------
+void emui_disconnect_all(EMTILE *scope)
+{
+	// tile is going away, it may have been on the focus path
+	handler_gen++;
+
+	while (scope->connections) {
+		CONN *c = scope->connections;
+		_remove(_find(scope, c->type, c->sender));
+	}
+}
+
+// -----------------------------------------------------------------------
+int emui_connection_run(EMTILE *t, struct emui_event *ev)
+{
+	if (!t->connections) return E_UNHANDLED;
+
+	// exact match first, then the catch-all handler for event type
+	CONN *c = *_find(t, ev->type, ev->sender);
+	if (!c) {
+		c = *_find(t, ev->type, EV_ANY_SENDER);
+	}
+
+	if (c) {
+		EDBG(t, 3, "running connected handler for event %i:%i", ev->type, ev->sender);
+		return c->handler(t, ev);
+	}
+
+	return E_UNHANDLED;
+}
+
+// -----------------------------------------------------------------------
+void emui_dispatch_invalidate()
+{
+	handler_gen++;
+}
+
+// -----------------------------------------------------------------------
+static unsigned _dhash(int type, int sender)
+{
+	uint32_t h = (uint32_t) type * 0x9e3779b1u;
+	h ^= (uint32_t) sender * 0x85ebca6bu;
+	h ^= h >> 16;
+	h *= 0x7feb352du;
+	h ^= h >> 15;
+	return h & (dtab_size - 1);
+}
+
+// -----------------------------------------------------------------------
+static CONN ** _dfind(int type, int sender)
+{
+	CONN **d = dtab + _dhash(type, sender);
+
+	while (*d && (((*d)->type != type) || ((*d)->sender != sender))) {
+		d = &(*d)->dnext;
+	}
+
+	return d;
+}
+
+// -----------------------------------------------------------------------
+static void _dscope_push(EMTILE *scope)
+{
+	for (CONN *c=scope->connections ; c ; c=c->scope_next) {
+		CONN **d = _dfind(c->type, c->sender);
+		// hide outer scope's connection for the same event
+		c->shadow = *d;
+		c->dnext = *d ? (*d)->dnext : NULL;
+		*d = c;
+	}
+	dscopes[dscopes_count++] = scope;
+}
+
+// -----------------------------------------------------------------------
+static void _dscope_pop()
+{
+	EMTILE *scope = dscopes[--dscopes_count];
+
+	// innermost scope's connections are always on top, uncover what they hid
+	for (CONN *c=scope->connections ; c ; c=c->scope_next) {
+		CONN **d = _dfind(c->type, c->sender);
+		if (c->shadow) {
+			c->shadow->dnext = c->dnext;
+			*d = c->shadow;
+		} else {
+			*d = c->dnext;
+		}
+	}
+}
+
+// -----------------------------------------------------------------------
+static int _has_own_handlers(EMTILE *t)
+{
+	return t->keymap || t->key_handler || t->drv->event_handler || (t->properties & P_FOCUS_GROUP);
+}
+
+// -----------------------------------------------------------------------
+static int _dpath_grow(int size)
+{
+	if (size <= dpath_size) return E_OK;
+
+	int nsize = dpath_size ? dpath_size : 32;
+	while (nsize < size) nsize *= 2;
+
+	// all three hold at most one entry per tile on the focus path
+	EMTILE **p = realloc(dpath, nsize * sizeof(EMTILE *));
+	if (!p) return E_ALLOC;
+	dpath = p;
+	p = realloc(dscopes, nsize * sizeof(EMTILE *));
+	if (!p) return E_ALLOC;
+	dscopes = p;
+	p = realloc(downers, nsize * sizeof(EMTILE *));
+	if (!p) return E_ALLOC;
+	downers = p;
+
+	dpath_size = nsize;
+
+	return E_OK;
+}
+
+// -----------------------------------------------------------------------
+static int _dispatch_sync(EMTILE *focus, unsigned long epoch)
+{
+	// connections or handlers have changed, start over
+	if (dtab_gen != handler_gen) {
+		unsigned size = CTAB_MIN_SIZE;
+		while (size < ctab_count) size *= 2;
+		if (size != dtab_size) {
+			CONN **ntab = realloc(dtab, size * sizeof(CONN *));
+			if (!ntab) return E_ALLOC;
+			dtab = ntab;
+			dtab_size = size;
+		}
+		for (unsigned i=0 ; i<dtab_size ; i++) {
+			dtab[i] = NULL;
+		}
+		dscopes_count = 0;
+		dtab_gen = handler_gen;
+	}
+
+	if (_dpath_grow(focus->depth + 1) != E_OK) {
+		return E_ALLOC;
+	}
+
+	// scopes and handler owners on the new focus path
+	int count = 0;
+	downers_count = 0;
+	for (EMTILE *t=focus ; t ; t=t->parent) {
+		if (t->connections) {
+			dpath[count++] = t;
+		}
+		if (_has_own_handlers(t)) {
+			downers[downers_count++] = t;
+		}
+	}
+
+	// keep scopes the old and the new path share
+	int common = 0;
+	while ((common < dscopes_count) && (common < count) && (dscopes[common] == dpath[count-1-common])) {
+		common++;
+	}
+	while (dscopes_count > common) {
+		_dscope_pop();
+	}
+	for (int i=count-1-common ; i>=0 ; i--) {
+		_dscope_push(dpath[i]);
+	}
+
+	dtab_epoch = epoch;
+
+	return E_OK;
+}
+
+// -----------------------------------------------------------------------
+static int _dispatch_walk(EMTILE *t, struct emui_event *ev)
+{
+	while (t) {
+		if (emtile_event(t, ev) == E_HANDLED) {
+			return E_HANDLED;
+		}
+		t = t->parent;
+	}
+
+	return E_UNHANDLED;
+}
+
+// -----------------------------------------------------------------------
+int emui_dispatch(struct emui_event *ev)
+{
+	EMTILE *focus = emui_focus_get();
+	CONN *d = NULL;
+	int i = 0;
+
+	if (!focus) return E_UNHANDLED;
+
+	unsigned long epoch = emui_focus_epoch_get();
+	if ((dtab_epoch != epoch) || (dtab_gen != handler_gen)) {
+		if (_dispatch_sync(focus, epoch) != E_OK) {
+			// no table, check everything along the path
+			dtab_gen = handler_gen - 1;
+			return _dispatch_walk(focus, ev);
+		}
+	}
+
+	if (dscopes_count) {
+		// exact match first, then the catch-all handler, unless it's for an inner scope
+		d = *_dfind(ev->type, ev->sender);
+		CONN *dany = *_dfind(ev->type, EV_ANY_SENDER);
+		if (dany && (!d || (dany->scope->depth > d->scope->depth))) {
+			d = dany;
+		}
+	}
+
+	// tiles below the scope get the event first
+	for ( ; i<downers_count ; i++) {
+		EMTILE *t = downers[i];
+		if (d && (t->depth <= d->scope->depth)) break;
+		if (emtile_event_handlers(t, ev) == E_HANDLED) {
+			return E_HANDLED;
+		}
+	}
+
+	if (!d) return E_UNHANDLED;
+
+	EDBG(d->scope, 3, "running connected handler for event %i:%i", ev->type, ev->sender);
+	if (d->handler(d->scope, ev) == E_HANDLED) {
+		return E_HANDLED;
+	}
+
+	// connected handler passed, continue as usual from the scope
+	if (emtile_event_handlers(d->scope, ev) == E_HANDLED) {
+		return E_HANDLED;
+	}
+
+	return _dispatch_walk(d->scope->parent, ev);
+}
+
+// -----------------------------------------------------------------------
+void emui_connections_destroy()
+{
+	for (unsigned i=0 ; i<ctab_size ; i++) {
+		CONN *c = ctab[i];
+		while (c) {
+			CONN *next = c->next;
+			c->scope->connections = NULL;
+			free(c);
+			c = next;
+		}
+	}
+
+	free(ctab);
+	ctab = NULL;
+	ctab_size = 0;
+	ctab_count = 0;
+
+	free(dtab);
+	free(dscopes);
+	free(downers);
+	free(dpath);
+	dtab = NULL;
+	dscopes = downers = dpath = NULL;
+	dtab_size = 0;
+	dscopes_count = downers_count = dpath_size = 0;
+	dtab_epoch = 0;
+	dtab_gen = handler_gen + 1;
+}
+
+// vim: tabstop=4 shiftwidth=4 autoindent
@@ -0,0 +1,328 @@
+//  Copyright (c) 2015 Jakub Filipowicz <jakubf@gmail.com>
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc.,
+//  51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+
+#include <stdlib.h>
+#include <limits.h>
+
+#include "tile.h"
+#include "event.h"
+
+// Flex container lays out any number of children one after another
+// along a single axis. Each child gets at least its minimum size,
+// then the remaining space is shared by weights (up to maximum sizes).
+// If even the minimum sizes don't fit, children with the lowest
+// priority are hidden first (later ones first, if priorities are equal).
+//
+// Children without a flex hint keep their requested size.
+
+struct flex_item {
+	EMTILE *t;
+	int min, max;
+	int weight;
+	int priority;
+	int size;
+	int hidden;
+	int capped;
+};
+
+// Sort key, holds everything the comparators need,
+// so no shared state is used for sorting
+struct flex_key {
+	int index;
+	int priority;
+	int room;
+	int weight;
+};
+
+struct flex {
+	int align;
+	struct flex_item *items;
+	struct flex_key *keys;
+	int size;
+};
+
+// -----------------------------------------------------------------------
+static int _flex_grow(struct flex *d, int count)
+{
+	if (count <= d->size) return E_OK;
+
+	int size = d->size ? d->size : 8;
+	while (size < count) size *= 2;
+
+	struct flex_item *items = realloc(d->items, size * sizeof(struct flex_item));
+	if (!items) return E_ALLOC;
+	d->items = items;
+	struct flex_key *keys = realloc(d->keys, size * sizeof(struct flex_key));
+	if (!keys) return E_ALLOC;
+	d->keys = keys;
+
+	d->size = size;
+
+	return E_OK;
+}
+
+// -----------------------------------------------------------------------
+static int _hide_cmp(const void *a, const void *b)
+{
+	const struct flex_key *k1 = a;
+	const struct flex_key *k2 = b;
+
+	// lowest priority first, later children first if priorities are equal
+	if (k1->priority != k2->priority) {
+		return k1->priority < k2->priority ? -1 : 1;
+	}
+	return k2->index - k1->index;
+}
+
+// -----------------------------------------------------------------------
+static int _cap_cmp(const void *a, const void *b)
+{
+	const struct flex_key *k1 = a;
+	const struct flex_key *k2 = b;
+
+	// children that reach their maximum size first (room/weight) go first
+	long long r1 = (long long) k1->room * k2->weight;
+	long long r2 = (long long) k2->room * k1->weight;
+	if (r1 != r2) {
+		return r1 < r2 ? -1 : 1;
+	}
+	return k1->index - k2->index;
+}
+
+// -----------------------------------------------------------------------
+static void _flex_hide(struct flex *d, int count, int *sum_min, int space)
+{
+	for (int i=0 ; i<count ; i++) {
+		d->keys[i].index = i;
+		d->keys[i].priority = d->items[i].priority;
+	}
+	qsort(d->keys, count, sizeof(struct flex_key), _hide_cmp);
+
+	for (int i=0 ; (i<count) && (*sum_min > space) ; i++) {
+		struct flex_item *it = d->items + d->keys[i].index;
+		it->hidden = 1;
+		*sum_min -= it->min;
+	}
+}
+
+// -----------------------------------------------------------------------
+static void _flex_share(struct flex *d, int count, int left)
+{
+	int n = 0;
+	long long total_weight = 0;
+
+	if (left <= 0) return;
+
+	for (int i=0 ; i<count ; i++) {
+		struct flex_item *it = d->items + i;
+		if (it->hidden || (it->weight <= 0)) continue;
+		d->keys[n].index = i;
+		d->keys[n].room = it->max - it->size;
+		d->keys[n].weight = it->weight;
+		total_weight += it->weight;
+		n++;
+	}
+
+	// nobody wants more space
+	if (!n) return;
+
+	qsort(d->keys, n, sizeof(struct flex_key), _cap_cmp);
+
+	// Children are sorted by the share of space at which they get capped.
+	// If a child doesn't reach its maximum, none of the following ones do.
+	// Capped children release the rest of their share to those that follow.
+	for (int k=0 ; k<n ; k++) {
+		struct flex_key *key = d->keys + k;
+		if ((long long) left * key->weight / total_weight < key->room) break;
+		struct flex_item *it = d->items + key->index;
+		it->size += key->room;
+		it->capped = 1;
+		left -= key->room;
+		total_weight -= key->weight;
+	}
+
+	if (!total_weight) return;
+
+	// share what's left by weights among children that aren't capped
+	int given = 0;
+	for (int i=0 ; i<count ; i++) {
+		struct flex_item *it = d->items + i;
+		if (it->hidden || it->capped || (it->weight <= 0)) continue;
+		int share = (long long) left * it->weight / total_weight;
+		it->size += share;
+		given += share;
+	}
+	left -= given;
+
+	// rounding leftovers go to the first children
+	for (int i=0 ; (i<count) && (left > 0) ; i++) {
+		struct flex_item *it = d->items + i;
+		if (!it->hidden && !it->capped && (it->weight > 0)) {
+			it->size++;
+			left--;
+		}
+	}
+}
+
+// -----------------------------------------------------------------------
+static inline void geom(EMTILE *ch, int x, int y, int w, int h)
+{
+	// disable it, if doesn't fit
+	if ((w <= 0) || (h <= 0)) {
+		ch->properties |= P_HIDDEN;
+	} else {
+		ch->properties &= ~P_HIDDEN;
+		ch->e.x = x;
+		ch->e.y = y;
+		ch->e.w = w;
+		ch->e.h = h;
+	}
+}
+
+// -----------------------------------------------------------------------
+void emui_flex_update_geometry(EMTILE *t)
+{
+	struct flex *d = t->priv_data;
+	int horizontal, space;
+	int count = 0;
+	int sum_min = 0;
+
+	if (!d) return;
+
+	horizontal = (d->align == AL_HORIZONTAL);
+	space = horizontal ? t->i.w : t->i.h;
+
+	for (EMTILE *ch=t->ch_first ; ch ; ch=ch->ch_next) {
+		count++;
+	}
+	if (_flex_grow(d, count) != E_OK) {
+		return;
+	}
+
+	// gather constraints, everyone starts at minimum size
+	struct flex_item *it = d->items;
+	for (EMTILE *ch=t->ch_first ; ch ; ch=ch->ch_next, it++) {
+		ch->properties |= P_GEOM_FORCED;
+		it->t = ch;
+		if (ch->fx.set) {
+			it->min = ch->fx.min > 0 ? ch->fx.min : 0;
+			it->max = ch->fx.max;
+			it->weight = ch->fx.weight;
+			it->priority = ch->fx.priority;
+			// translate "special" requirements to actual lengths
+			if (it->max < 0) {
+				it->max = space / -it->max;
+			} else if (it->max == 0) {
+				it->max = INT_MAX;
+			}
+			if (it->max < it->min) {
+				it->max = it->min;
+			}
+		} else {
+			it->min = it->max = horizontal ? ch->r.w : ch->r.h;
+			it->weight = 0;
+			it->priority = 0;
+		}
+		it->size = it->min;
+		it->hidden = 0;
+		it->capped = 0;
+		sum_min += it->min;
+	}
+
+	// not enough space even for minimum sizes
+	if (sum_min > space) {
+		_flex_hide(d, count, &sum_min, space);
+	}
+
+	_flex_share(d, count, space - sum_min);
+
+	// set children geometry
+	int offset = 0;
+	for (int i=0 ; i<count ; i++) {
+		it = d->items + i;
+		int size = it->hidden ? 0 : it->size;
+		if (horizontal) {
+			geom(it->t, t->i.x + offset, t->i.y, size, t->i.h);
+		} else {
+			geom(it->t, t->i.x, t->i.y + offset, t->i.w, size);
+		}
+		offset += size;
+	}
+}
+
+// -----------------------------------------------------------------------
+void emui_flex_destroy_priv_data(EMTILE *t)
+{
+	struct flex *d = t->priv_data;
+
+	free(d->items);
+	free(d->keys);
+	emtile_priv_free(t);
+}
+
+// -----------------------------------------------------------------------
+struct emtile_drv emui_flex_drv = {
+	.draw = NULL,
+	.update_children_geometry = emui_flex_update_geometry,
+	.event_handler = NULL,
+	.destroy_priv_data = emui_flex_destroy_priv_data,
+	.pure_geometry = 1,
+};
+
+// -----------------------------------------------------------------------
+int emui_flex_hint(EMTILE *t, int min, int max, int weight, int priority)
+{
+	if (!t->parent || (t->parent->drv != &emui_flex_drv)) {
+		return E_CONFLICT;
+	}
+
+	t->fx.set = 1;
+	t->fx.min = min;
+	t->fx.max = max;
+	t->fx.weight = weight;
+	t->fx.priority = priority;
+
+	emtile_geometry_changed(t->parent);
+
+	return E_OK;
+}
+
+// -----------------------------------------------------------------------
+EMTILE * emui_flex(EMTILE *parent, int align)
+{
+	EMTILE *t;
+
+	if ((align != AL_HORIZONTAL) && (align != AL_VERTICAL)) {
+		return NULL;
+	}
+
+	t = emtile(parent, &emui_flex_drv, 0, 0, parent->i.w, parent->i.h, 0, 0, 0, 0, "Flex", P_CONTAINER | P_MAXIMIZE);
+
+	if (!t) return NULL;
+
+	t->priv_data = emtile_priv_alloc(t, sizeof(struct flex));
+
+	struct flex *d = t->priv_data;
+
+	d->align = align;
+
+	emtile_geometry_changed(t);
+
+	return t;
+}
+
+// vim: tabstop=4 shiftwidth=4 autoindent
@@ -68,7 +68,7 @@ void emui_grid_update_geometry(EMTILE *t)
 // -----------------------------------------------------------------------
 void emui_grid_destroy_priv_data(EMTILE *t)
 {
-	free(t->priv_data);
+	emtile_priv_free(t);
 }
 
 // -----------------------------------------------------------------------
@@ -77,6 +77,7 @@ struct emtile_drv emui_grid_drv = {
 	.update_children_geometry = emui_grid_update_geometry,
 	.event_handler = NULL,
 	.destroy_priv_data = emui_grid_destroy_priv_data,
+	.pure_geometry = 1,
 };
 
 // -----------------------------------------------------------------------
@@ -86,7 +87,7 @@ EMTILE * emui_grid(EMTILE *parent, int cols, int rows, int col_width, int row_he
 
 	t = emtile(parent, &emui_grid_drv, 0, 0, parent->i.w, parent->i.h, 0, 0, 0, 0, "Grid", P_CONTAINER | P_MAXIMIZE);
 
-	t->priv_data = calloc(1, sizeof(struct grid));
+	t->priv_data = emtile_priv_alloc(t, sizeof(struct grid));
 
 	struct grid *d = t->priv_data;
 
@@ -70,6 +70,7 @@ struct emtile_drv emui_justifier_drv = {
 	.update_children_geometry = emui_justifier_update_geometry,
 	.event_handler = NULL,
 	.destroy_priv_data = NULL,
+	.pure_geometry = 1,
 };
 
 // -----------------------------------------------------------------------
@@ -16,46 +16,323 @@
 //  51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
 
 #include <stdlib.h>
+#include <string.h>
 
 #include "dbg.h"
 #include "tile.h"
 #include "event.h"
 
+// List container lays out its children (rows) one below another
+// and scrolls them vertically. Row heights are kept in a Fenwick tree,
+// so position of a row, row at a position and a height change
+// are all O(log n), and only rows within the viewport are laid out.
+//
+// Rows right above and below the viewport are laid out too, but hidden,
+// so that moving focus physically out of the viewport finds them
+// (and scrolls the list). All other rows are hidden and parked far
+// away from everything, where they don't get in the way.
+//
+// Rows appended to the list are indexed as they come, removing a row
+// has the whole list indexed again.
+//
+// Only rows laid out by the last update are drawn and laid out
+// by the tree walks, plus rows parked since the last walk (once,
+// so that they give their windows back and get hidden). Parked rows
+// are not visited at all, no matter how many of them there are.
+
+#define LIST_PARKED -(1 << 20)
+
 struct list {
 	int start_offset;
+	EMTILE **rows;		// children in order
+	int *bit;			// Fenwick tree of row heights (1-based)
+	int count;
+	int size;
+	int dirty;			// rows need to be indexed again
+	int first, last;	// rows laid out by the last update: [first, last)
+	EMTILE **parked;	// rows parked since the last walk over children
+	int parked_count;
+	int parked_size;
+	int visit_all;		// rows have been parked without a note, visit all once
+	EMTILE **visit;		// parked rows followed by the laid out ones
+	int visit_size;
 };
 
 // -----------------------------------------------------------------------
-void emui_list_update_geometry(EMTILE *t)
+static inline int _row_h(EMTILE *ch)
 {
-	EMTILE *ch = t->ch_first;
-	if (!ch) return;
+	return ch->r.h > 0 ? ch->r.h : 0;
+}
 
-	struct list *d = t->priv_data;
-	int y_offset = d->start_offset;
+// -----------------------------------------------------------------------
+static void _bit_add(struct list *d, int row, int delta)
+{
+	for (int i=row+1 ; i<=d->count ; i+=i&-i) {
+		d->bit[i] += delta;
+	}
+}
+
+// -----------------------------------------------------------------------
+static int _bit_sum(struct list *d, int row)
+{
+	int sum = 0;
+
+	// total height of rows above the row
+	for (int i=row ; i>0 ; i-=i&-i) {
+		sum += d->bit[i];
+	}
+
+	return sum;
+}
+
+// -----------------------------------------------------------------------
+static int _bit_find(struct list *d, int pos)
+{
+	int step = 1;
+	int row = 0;
+
+	if (pos <= 0) return 0;
+
+	while (step * 2 <= d->count) {
+		step *= 2;
+	}
+
+	// find the last row that starts before pos...
+	for ( ; step>0 ; step/=2) {
+		if ((row + step <= d->count) && (d->bit[row + step] < pos)) {
+			row += step;
+			pos -= d->bit[row];
+		}
+	}
+
+	// ...first one that starts at or after pos is the next one
+	return row < d->count ? row + 1 : d->count;
+}
+
+// -----------------------------------------------------------------------
+static int _list_grow(struct list *d, int count)
+{
+	if (count <= d->size) return E_OK;
+
+	int size = d->size ? d->size : 64;
+	while (size < count) size *= 2;
+
+	EMTILE **rows = realloc(d->rows, size * sizeof(EMTILE *));
+	if (!rows) return E_ALLOC;
+	d->rows = rows;
+	int *bit = realloc(d->bit, (size + 1) * sizeof(int));
+	if (!bit) return E_ALLOC;
+	d->bit = bit;
+
+	d->size = size;
+
+	return E_OK;
+}
+
+// -----------------------------------------------------------------------
+static void _list_park(struct list *d, EMTILE *ch)
+{
+	// row has been laid out elsewhere, it needs one more visit to be put away
+	if ((ch->e.x != LIST_PARKED) || (ch->e.y != LIST_PARKED)) {
+		if (d->parked_count >= d->parked_size) {
+			int size = d->parked_size ? d->parked_size * 2 : 64;
+			EMTILE **parked = realloc(d->parked, size * sizeof(EMTILE *));
+			if (parked) {
+				d->parked = parked;
+				d->parked_size = size;
+			}
+		}
+		if (d->parked_count < d->parked_size) {
+			d->parked[d->parked_count++] = ch;
+		} else {
+			d->visit_all = 1;
+		}
+	}
+
+	ch->properties |= P_GEOM_FORCED | P_HIDDEN;
+	ch->e.x = LIST_PARKED;
+	ch->e.y = LIST_PARKED;
+	ch->e.h = ch->r.h;
+}
+
+// -----------------------------------------------------------------------
+static int _list_index(EMTILE *t, struct list *d)
+{
+	int count = 0;
+
+	for (EMTILE *ch=t->ch_first ; ch ; ch=ch->ch_next) {
+		count++;
+	}
+	if (_list_grow(d, count) != E_OK) {
+		return E_ALLOC;
+	}
+
+	// build the tree in linear time: each node adds itself to its parent
+	d->count = 0;
+	d->bit[0] = 0;
+	for (EMTILE *ch=t->ch_first ; ch ; ch=ch->ch_next) {
+		_list_park(d, ch);
+		ch->list_row = d->count;
+		d->rows[d->count++] = ch;
+		d->bit[d->count] = _row_h(ch);
+	}
+	for (int i=1 ; i<=d->count ; i++) {
+		int parent = i + (i&-i);
+		if (parent <= d->count) {
+			d->bit[parent] += d->bit[i];
+		}
+	}
+
+	d->first = d->last = 0;
+	d->dirty = 0;
+
+	EDBG(t, 3, "list indexed: %i rows", d->count);
+
+	return E_OK;
+}
+
+// -----------------------------------------------------------------------
+static int _list_sync(EMTILE *t, struct list *d)
+{
+	if (d->dirty) {
+		return _list_index(t, d);
+	}
 
+	// children are always appended at the end
+	EMTILE *ch = d->count ? d->rows[d->count-1]->ch_next : t->ch_first;
 	while (ch) {
+		if (_list_grow(d, d->count + 1) != E_OK) {
+			return E_ALLOC;
+		}
+		_list_park(d, ch);
+		ch->list_row = d->count;
+		d->rows[d->count++] = ch;
+		// new node covers rows (i - lowbit(i), i]
+		int i = d->count;
+		d->bit[i] = _row_h(ch) + _bit_sum(d, i-1) - _bit_sum(d, i - (i&-i));
+		ch = ch->ch_next;
+	}
+
+	return E_OK;
+}
+
+// -----------------------------------------------------------------------
+void emui_list_update_geometry(EMTILE *t)
+{
+	struct list *d = t->priv_data;
+
+	if (!d || (_list_sync(t, d) != E_OK)) return;
+
+	// rows starting within the viewport are visible
+	int first = _bit_find(d, -d->start_offset);
+	int last = _bit_find(d, -d->start_offset + t->i.h);
+	if (last < first) last = first;
+
+	// rows next to the viewport are laid out, but hidden
+	int lay_first = first > 0 ? first - 1 : 0;
+	int lay_last = last < d->count ? last + 1 : d->count;
+
+	for (int k=d->first ; k<d->last ; k++) {
+		if ((k < lay_first) || (k >= lay_last)) {
+			EDBG(d->rows[k], 4, "list parking tile");
+			_list_park(d, d->rows[k]);
+		}
+	}
+
+	int y_offset = d->start_offset + _bit_sum(d, lay_first);
+	for (int k=lay_first ; k<lay_last ; k++) {
+		EMTILE *ch = d->rows[k];
 		ch->properties |= P_GEOM_FORCED;
 		ch->e.x = t->i.x;
 		ch->e.y = t->i.y + y_offset;
 		ch->e.w = t->i.w;
 		ch->e.h = ch->r.h;
-		y_offset += ch->r.h;
-		if ((ch->e.y < t->i.y) || (ch->e.y >= t->i.y + t->i.h)) {
+		y_offset += _row_h(ch);
+		if ((k < first) || (k >= last)) {
 			EDBG(ch, 4, "list hiding tile");
 			ch->properties |= P_HIDDEN;
 		} else {
 			EDBG(ch, 4, "list unhiding tile");
 			ch->properties &= ~P_HIDDEN;
 		}
-		ch = ch->ch_next;
+	}
+
+	d->first = lay_first;
+	d->last = lay_last;
+}
+
+// -----------------------------------------------------------------------
+void emui_list_child_removed(EMTILE *t, EMTILE *ch)
+{
+	struct list *d = t->priv_data;
+
+	if (d) {
+		// removed row may be among the parked ones
+		d->dirty = 1;
+		d->parked_count = 0;
+		d->visit_all = 1;
 	}
 }
 
 // -----------------------------------------------------------------------
 void emui_list_destroy_priv_data(EMTILE *t)
 {
-	free(t->priv_data);
+	struct list *d = t->priv_data;
+
+	free(d->rows);
+	free(d->bit);
+	free(d->parked);
+	free(d->visit);
+	emtile_priv_free(t);
+}
+
+// -----------------------------------------------------------------------
+EMTILE ** emui_list_visited_children(EMTILE *t, int *count)
+{
+	struct list *d = t->priv_data;
+
+	if (!d) return NULL;
+
+	// rows may be gone, or not indexed yet
+	if (d->dirty || (d->count ? d->rows[d->count-1]->ch_next : t->ch_first)) {
+		return NULL;
+	}
+
+	if (d->visit_all) {
+		d->visit_all = 0;
+		d->parked_count = 0;
+		return NULL;
+	}
+
+	if (!d->parked_count) {
+		*count = d->last - d->first;
+		return d->rows + d->first;
+	}
+
+	int size = d->parked_count + d->last - d->first;
+	if (size > d->visit_size) {
+		EMTILE **visit = realloc(d->visit, size * sizeof(EMTILE *));
+		if (!visit) return NULL;
+		d->visit = visit;
+		d->visit_size = size;
+	}
+
+	memcpy(d->visit, d->parked, d->parked_count * sizeof(EMTILE *));
+	memcpy(d->visit + d->parked_count, d->rows + d->first, (d->last - d->first) * sizeof(EMTILE *));
+	d->parked_count = 0;
+
+	*count = size;
+	return d->visit;
+}
+
+// -----------------------------------------------------------------------
+static void _list_refit_path(EMTILE *row, EMTILE *f)
+{
+	// lay out tiles from the row down to f (row keeps its geometry)
+	if (f != row) {
+		_list_refit_path(row, f->parent);
+	}
+	emtile_fit(f);
 }
 
 // -----------------------------------------------------------------------
@@ -63,14 +340,28 @@ void emui_list_scroll(EMTILE *t, EMTILE *f)
 {
 	struct list *d = t->priv_data;
 
-	// if f is below t view area
-	if (f->e.y >= t->i.y + t->i.h) {
-		d->start_offset += t->i.y + t->i.h - f->e.y - 1;
-	// if f is above t view area
-	} else if (f->e.y < t->i.y) {
-		d->start_offset += t->i.y - f->e.y;
+	EMTILE *row = f;
+	while (row && (row->parent != t)) {
+		row = row->parent;
 	}
-	EDBG(f, 4, "list scroll wants to show tile, offset is now: %i", d->start_offset);
+
+	// only rows that have been laid out already can be scrolled to
+	if (row && !d->dirty && (row->list_row < d->count) && (d->rows[row->list_row] == row)) {
+		// row may have been moved (parked) since its descendants were laid out
+		_list_refit_path(row, f);
+		// where the tile would be if the list was laid out in whole
+		int y = t->i.y + d->start_offset + _bit_sum(d, row->list_row) + f->e.y - row->e.y;
+		// if f is below t view area
+		if (y >= t->i.y + t->i.h) {
+			d->start_offset += t->i.y + t->i.h - y - 1;
+		// if f is above t view area
+		} else if (y < t->i.y) {
+			d->start_offset += t->i.y - y;
+		}
+		EDBG(f, 4, "list scroll wants to show tile, offset is now: %i", d->start_offset);
+	}
+
+	emtile_geometry_changed(t);
 }
 
 // -----------------------------------------------------------------------
@@ -80,16 +371,42 @@ struct emtile_drv emui_list_drv = {
 	.event_handler = NULL,
 	.destroy_priv_data = emui_list_destroy_priv_data,
 	.scroll_handler = emui_list_scroll,
+	.child_removed = emui_list_child_removed,
+	.pure_geometry = 1,
+	.visited_children = emui_list_visited_children,
 };
 
+// -----------------------------------------------------------------------
+int emui_list_row_height(EMTILE *row, int h)
+{
+	EMTILE *t = row->parent;
+
+	if (!t || (t->drv != &emui_list_drv)) {
+		return E_CONFLICT;
+	}
+
+	struct list *d = t->priv_data;
+	int old_h = _row_h(row);
+	row->r.h = h;
+
+	// rows not indexed yet pick up the height when they are
+	if (!d->dirty && (row->list_row < d->count) && (d->rows[row->list_row] == row)) {
+		_bit_add(d, row->list_row, _row_h(row) - old_h);
+	}
+
+	emtile_geometry_changed(t);
+
+	return E_OK;
+}
+
 // -----------------------------------------------------------------------
 EMTILE * emui_list(EMTILE *parent)
 {
 	EMTILE *t;
 
-	t = emtile(parent, &emui_list_drv, 0, 0, parent->i.w, parent->i.h, 0, 0, 0, 0, "List", P_CONTAINER | P_MAXIMIZE | P_FOCUS_GROUP);
+	t = emtile(parent, &emui_list_drv, 0, 0, parent->i.w, parent->i.h, 0, 0, 0, 0, "List", P_CONTAINER | P_MAXIMIZE | P_FOCUS_GROUP | P_LAYOUT_STATE);
 
-	t->priv_data = calloc(1, sizeof(struct list));
+	t->priv_data = emtile_priv_alloc(t, sizeof(struct list));
 	struct list *d = t->priv_data;
 	d->start_offset = 0;
 
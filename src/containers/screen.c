@@ -16,13 +16,13 @@
 //  51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
 
 #include <stdlib.h>
-#include <string.h>
 #include <ncurses.h>
 #include <sys/ioctl.h>
 #include <unistd.h>
 
 #include "tile.h"
 #include "event.h"
+#include "hitmap.h"
 
 // -----------------------------------------------------------------------
 void emui_screen_update_geometry(EMTILE *t)
@@ -33,6 +33,7 @@ void emui_screen_update_geometry(EMTILE *t)
 	clear();
 	t->i.h = t->r.h = LINES;
 	t->i.w = t->r.w = COLS;
+	emui_hitmap_resize(t, COLS, LINES);
 	t->geometry_changed = 1;
 }
 
@@ -47,11 +48,11 @@ struct emtile_drv emui_screen_drv = {
 // -----------------------------------------------------------------------
 EMTILE * emui_screen()
 {
-	EMTILE *t = calloc(1, sizeof(EMTILE));
+	EMTILE *t = _emtile_alloc(NULL);
 	t->ncwin = stdscr;
 	t->drv = &emui_screen_drv;
-	t->name = strdup("SCREEN");
-	t->properties = P_CONTAINER | P_FOCUS_GROUP;
+	emtile_set_name(t, "SCREEN");
+	t->properties = P_CONTAINER | P_FOCUS_GROUP | P_LAYOUT_SERIAL;
 	t->i.x = t->r.x = t->e.x = 0;
 	t->i.y = t->r.y = t->e.y = 0;
 	t->mr = t->ml = t->mt = t->mb = 0;
@@ -139,7 +139,7 @@ void emui_splitter_update_geometry(EMTILE *t)
 // -----------------------------------------------------------------------
 void emui_splitter_destroy_priv_data(EMTILE *t)
 {
-	free(t->priv_data);
+	emtile_priv_free(t);
 }
 
 // -----------------------------------------------------------------------
@@ -148,6 +148,7 @@ struct emtile_drv emui_splitter_drv = {
 	.update_children_geometry = emui_splitter_update_geometry,
 	.event_handler = NULL,
 	.destroy_priv_data = emui_splitter_destroy_priv_data,
+	.pure_geometry = 1,
 };
 
 // -----------------------------------------------------------------------
@@ -163,7 +164,7 @@ EMTILE * emui_splitter(EMTILE *parent, int edge, int min1, int max1, int min2)
 
 	if (!t) return NULL;
 
-	t->priv_data = calloc(1, sizeof(struct splitter));
+	t->priv_data = emtile_priv_alloc(t, sizeof(struct splitter));
 
 	struct splitter *d = t->priv_data;
 
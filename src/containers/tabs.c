@@ -71,7 +71,7 @@ void emui_tabs_update_geometry(EMTILE *t)
 // -----------------------------------------------------------------------
 void emui_tabs_destroy_priv_data(EMTILE *t)
 {
-	free(t->priv_data);
+	emtile_priv_free(t);
 }
 
 // -----------------------------------------------------------------------
@@ -85,9 +85,9 @@ struct emtile_drv emui_tabs_drv = {
 // -----------------------------------------------------------------------
 EMTILE * emui_tabs(EMTILE *parent)
 {
-	EMTILE *t = emtile(parent, &emui_tabs_drv, 0, 0, parent->i.w, parent->i.h, 1, 0, 0, 0, "Tabs", P_CONTAINER | P_MAXIMIZE | P_FOCUS_GROUP);
+	EMTILE *t = emtile(parent, &emui_tabs_drv, 0, 0, parent->i.w, parent->i.h, 1, 0, 0, 0, "Tabs", P_CONTAINER | P_MAXIMIZE | P_FOCUS_GROUP | P_LAYOUT_STATE);
 
-	t->priv_data = calloc(1, sizeof(struct tabs));
+	t->priv_data = emtile_priv_alloc(t, sizeof(struct tabs));
 
 	return t;
 }
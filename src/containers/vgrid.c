@@ -0,0 +1,321 @@
+//  Copyright (c) 2015 Jakub Filipowicz <jakubf@gmail.com>
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc.,
+//  51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+
+
+#include <stdlib.h>
+#include <ncurses.h>
+
+#include "dbg.h"
+#include "tile.h"
+#include "tiles.h"
+#include "event.h"
+
+// Virtual grid shows a window into a (possibly huge) rows x cols data grid.
+// Only as many cell tiles as fit in the viewport are ever created.
+// When the view scrolls, cells stay where they are and get rebound
+// to new data positions with the app-provided cell() callback.
+// Cells being edited are never rebound, edits would end up in the wrong place.
+
+struct vgrid {
+	int rows, cols;			// data grid size
+	int col_width;
+	int row_height;
+	int col_spacing;
+	int top, left;			// data position shown in the top-left cell
+	int vrows, vcols;		// viewport size (in cells)
+	emui_vgrid_new_f cell_new;
+	emui_vgrid_cell_f cell;
+	EMTILE **cells;			// cell tiles, row by row
+	int *pos;				// data index each cell is currently bound to
+	int count;				// cell tiles created
+	int size;				// cells[] and pos[] capacity
+};
+
+// -----------------------------------------------------------------------
+static int _vgrid_grow(struct vgrid *d, int size)
+{
+	EMTILE **cells = realloc(d->cells, size * sizeof(EMTILE *));
+	if (!cells) return E_ALLOC;
+	d->cells = cells;
+
+	int *pos = realloc(d->pos, size * sizeof(int));
+	if (!pos) return E_ALLOC;
+	d->pos = pos;
+	for (int k=d->size ; k<size ; k++) {
+		d->pos[k] = -1;
+	}
+
+	d->size = size;
+
+	return E_OK;
+}
+
+// -----------------------------------------------------------------------
+static void _vgrid_clamp(struct vgrid *d)
+{
+	if (d->top > d->rows - d->vrows) d->top = d->rows - d->vrows;
+	if (d->top < 0) d->top = 0;
+	if (d->left > d->cols - d->vcols) d->left = d->cols - d->vcols;
+	if (d->left < 0) d->left = 0;
+}
+
+// -----------------------------------------------------------------------
+static void _vgrid_bind(EMTILE *t)
+{
+	struct vgrid *d = t->priv_data;
+
+	for (int k=0 ; k<d->vrows*d->vcols ; k++) {
+		int row = d->top + k / d->vcols;
+		int col = d->left + k % d->vcols;
+		int pos = row * d->cols + col;
+		// rebind only cells that show something else now,
+		// cell being edited is rebound once editing is done
+		if ((d->pos[k] != pos) && d->cells[k]->accept_updates) {
+			d->pos[k] = pos;
+			d->cell(t, d->cells[k], row, col);
+		}
+	}
+}
+
+// -----------------------------------------------------------------------
+void emui_vgrid_update_geometry(EMTILE *t)
+{
+	struct vgrid *d = t->priv_data;
+	if (!d) return; // first fit happens before priv_data is set
+
+	int vcols = d->vcols;
+
+	d->vrows = t->i.h / d->row_height;
+	d->vcols = (t->i.w + d->col_spacing) / (d->col_width + d->col_spacing);
+	if (d->vrows > d->rows) d->vrows = d->rows;
+	if (d->vcols > d->cols) d->vcols = d->cols;
+	if (d->vrows < 0) d->vrows = 0;
+	if (d->vcols < 0) d->vcols = 0;
+	_vgrid_clamp(d);
+
+	int needed = d->vrows * d->vcols;
+
+	// create missing cells, excess cells are just hidden for later
+	while (d->count < needed) {
+		if ((d->count >= d->size) && (_vgrid_grow(d, d->size ? d->size * 2 : 64) != E_OK)) {
+			break;
+		}
+		EMTILE *c = d->cell_new(t);
+		if (!c) break;
+		d->cells[d->count++] = c;
+	}
+	if (needed > d->count) {
+		needed = d->count;
+		d->vrows = d->vcols ? needed / d->vcols : 0;
+		needed = d->vrows * d->vcols;
+	}
+
+	for (int k=0 ; k<d->count ; k++) {
+		EMTILE *ch = d->cells[k];
+		ch->properties |= P_GEOM_FORCED;
+		if (k < needed) {
+			ch->e.x = t->i.x + (k % d->vcols) * (d->col_width + d->col_spacing);
+			ch->e.y = t->i.y + (k / d->vcols) * d->row_height;
+			ch->e.w = d->col_width;
+			ch->e.h = d->row_height;
+			ch->properties &= ~P_HIDDEN;
+		} else {
+			ch->properties |= P_HIDDEN;
+		}
+		// cells are laid out differently, all need rebinding
+		if (vcols != d->vcols) {
+			d->pos[k] = -1;
+		}
+	}
+
+	_vgrid_bind(t);
+}
+
+// -----------------------------------------------------------------------
+static int _vgrid_focused_cell(EMTILE *t)
+{
+	struct vgrid *d = t->priv_data;
+
+	for (int k=0 ; k<d->vrows*d->vcols ; k++) {
+		if (d->cells[k] == t->focus) {
+			return k;
+		}
+	}
+
+	return -1;
+}
+
+// -----------------------------------------------------------------------
+void emui_vgrid_scroll_to(EMTILE *t, int row, int col)
+{
+	struct vgrid *d = t->priv_data;
+
+	d->top = row;
+	d->left = col;
+	_vgrid_clamp(d);
+	_vgrid_bind(t);
+}
+
+// -----------------------------------------------------------------------
+static int _vgrid_editing(struct vgrid *d)
+{
+	for (int k=0 ; k<d->vrows*d->vcols ; k++) {
+		if (!d->cells[k]->accept_updates) {
+			return 1;
+		}
+	}
+
+	return 0;
+}
+
+// -----------------------------------------------------------------------
+static int _vgrid_scroll(EMTILE *t, int drow, int dcol)
+{
+	struct vgrid *d = t->priv_data;
+	int top = d->top;
+	int left = d->left;
+
+	// view stays put until the edit is finished
+	if (_vgrid_editing(d)) {
+		return E_HANDLED;
+	}
+
+	emui_vgrid_scroll_to(t, d->top + drow, d->left + dcol);
+
+	return ((top != d->top) || (left != d->left)) ? E_HANDLED : E_UNHANDLED;
+}
+
+// -----------------------------------------------------------------------
+int emui_vgrid_event_handler(EMTILE *t, struct emui_event *ev)
+{
+	struct vgrid *d = t->priv_data;
+
+	if (ev->type == EV_MOUSE) {
+		switch (ev->sender) {
+			case MB_WHEEL_UP:
+				_vgrid_scroll(t, -1, 0);
+				return E_HANDLED;
+			case MB_WHEEL_DOWN:
+				_vgrid_scroll(t, 1, 0);
+				return E_HANDLED;
+			default:
+				return E_UNHANDLED;
+		}
+	}
+
+	if (ev->type != EV_KEY) return E_UNHANDLED;
+
+	int k = _vgrid_focused_cell(t);
+	if (k < 0) return E_UNHANDLED;
+
+	int row = k / d->vcols;
+	int col = k % d->vcols;
+
+	// moving focus past the viewport edge scrolls the data instead,
+	// moves within the viewport are regular focus group moves
+	switch (ev->sender) {
+		case KEY_UP:
+			return row == 0 ? _vgrid_scroll(t, -1, 0) : E_UNHANDLED;
+		case KEY_DOWN:
+			return row == d->vrows-1 ? _vgrid_scroll(t, 1, 0) : E_UNHANDLED;
+		case KEY_LEFT:
+			return col == 0 ? _vgrid_scroll(t, 0, -1) : E_UNHANDLED;
+		case KEY_RIGHT:
+			return col == d->vcols-1 ? _vgrid_scroll(t, 0, 1) : E_UNHANDLED;
+		case KEY_PPAGE:
+			_vgrid_scroll(t, -d->vrows, 0);
+			return E_HANDLED;
+		case KEY_NPAGE:
+			_vgrid_scroll(t, d->vrows, 0);
+			return E_HANDLED;
+		default:
+			return E_UNHANDLED;
+	}
+}
+
+// -----------------------------------------------------------------------
+void emui_vgrid_destroy_priv_data(EMTILE *t)
+{
+	struct vgrid *d = t->priv_data;
+
+	free(d->cells);
+	free(d->pos);
+	emtile_priv_free(t);
+}
+
+// -----------------------------------------------------------------------
+struct emtile_drv emui_vgrid_drv = {
+	.draw = NULL,
+	.update_children_geometry = emui_vgrid_update_geometry,
+	.event_handler = emui_vgrid_event_handler,
+	.destroy_priv_data = emui_vgrid_destroy_priv_data,
+};
+
+// -----------------------------------------------------------------------
+EMTILE * emui_vgrid(EMTILE *parent, int rows, int cols, int col_width, int row_height, int col_spacing, emui_vgrid_new_f cell_new, emui_vgrid_cell_f cell)
+{
+	EMTILE *t;
+
+	t = emtile(parent, &emui_vgrid_drv, 0, 0, parent->i.w, parent->i.h, 0, 0, 0, 0, "VGrid", P_CONTAINER | P_MAXIMIZE | P_FOCUS_GROUP | P_LAYOUT_STATE | P_LAYOUT_SERIAL);
+	if (!t) return NULL;
+
+	t->priv_data = emtile_priv_alloc(t, sizeof(struct vgrid));
+
+	struct vgrid *d = t->priv_data;
+
+	d->rows = rows;
+	d->cols = cols;
+	d->col_width = col_width;
+	d->row_height = row_height > 0 ? row_height : 1;
+	d->col_spacing = col_spacing;
+	d->cell_new = cell_new;
+	d->cell = cell;
+
+	// cells are created with the next fit
+	emtile_geometry_changed(t);
+
+	return t;
+}
+
+// -----------------------------------------------------------------------
+void emui_vgrid_set_size(EMTILE *t, int rows, int cols)
+{
+	struct vgrid *d = t->priv_data;
+
+	d->rows = rows;
+	d->cols = cols;
+	emtile_geometry_changed(t);
+}
+
+// -----------------------------------------------------------------------
+int emui_vgrid_get_pos(EMTILE *cell, int *row, int *col)
+{
+	EMTILE *t = cell->parent;
+	struct vgrid *d = t->priv_data;
+
+	for (int k=0 ; k<d->vrows*d->vcols ; k++) {
+		if ((d->cells[k] == cell) && (d->pos[k] >= 0)) {
+			*row = d->pos[k] / d->cols;
+			*col = d->pos[k] % d->cols;
+			return E_OK;
+		}
+	}
+
+	return -1;
+}
+
+// vim: tabstop=4 shiftwidth=4 autoindent
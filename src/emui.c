@@ -29,6 +29,16 @@
 #include "tiles.h"
 #include "style.h"
 #include "focus.h"
+#include "hitmap.h"
+#include "tilepath.h"
+#include "lcache.h"
+#include "compose.h"
+#include "mouse.h"
+#include "paste.h"
+#include "connect.h"
+#include "tiletab.h"
+#include "winpool.h"
+#include "lpool.h"
 
 #define EMUI_FPS_CAP 1000
 #define EMUI_WORK_COEFFICIENT 1.1
@@ -40,6 +50,7 @@ static int fps_target;
 static int fps_frame_mod;
 static float fps_current;
 static unsigned long frame_current;
+static unsigned long draw_seq;
 static volatile int terminal_resized;
 
 // -----------------------------------------------------------------------
@@ -64,6 +75,8 @@ EMTILE * emui_init(unsigned fps)
 	set_escdelay(100);
 	start_color();
 	emui_style_init(NULL);
+	emui_mouse_enable();
+	emui_paste_enable();
 
 	// initialize emui
 	if (fps > EMUI_FPS_CAP) {
@@ -90,6 +103,17 @@ EMTILE * emui_init(unsigned fps)
 void emui_destroy()
 {
 	_emtile_really_delete(layout);
+	_emtile_allocators_destroy();
+	emui_winpool_destroy();
+	emui_tiletab_destroy();
+	emui_hitmap_destroy();
+	emui_path_destroy();
+	emui_lcache_destroy();
+	emui_compose_destroy();
+	emui_lpool_destroy();
+	emui_connections_destroy();
+	emui_mouse_disable();
+	emui_paste_disable();
 	endwin();
 	//_nc_free_and_exit();
 	delscreen(s);
@@ -100,26 +124,35 @@ void emui_destroy()
 static int emui_evq_update(struct timeval *tv)
 {
 	static fd_set rfds;
-	int retval;
+	int retval = 1;
 	int ch;
 	struct emui_event *ev = NULL;
 
-	FD_ZERO(&rfds);
-	FD_SET(0, &rfds);
+	// ncurses may already hold characters that were read ahead
+	// or pushed back, select() won't report those
+	ch = getch();
 
-	retval = select(1, &rfds, NULL, NULL, tv);
+	if (ch == ERR) {
+		FD_ZERO(&rfds);
+		FD_SET(0, &rfds);
 
-	if (retval == 0) {
-		return 0;
+		retval = select(1, &rfds, NULL, NULL, tv);
+
+		if (retval == 0) {
+			return 0;
+		} else if (retval > 0) {
+			ch = getch();
+		}
 	}
 
 	ev = calloc(1, sizeof(struct emui_event));
 
-	// we have a keypress
+	// we have a keypress, a mouse event or a paste
 	if (retval > 0) {
-		ch = getch();
-		ev->type = EV_KEY;
-		ev->sender = ch;
+		if ((ch != 27) || !(emui_mouse_sgr_read(ev) || emui_paste_read(ev))) {
+			ev->type = EV_KEY;
+			ev->sender = ch;
+		}
 	// error
 	} else {
 		ev->type = EV_ERROR;
@@ -132,81 +165,197 @@ static int emui_evq_update(struct timeval *tv)
 }
 
 // -----------------------------------------------------------------------
-static void emui_draw(EMTILE *t)
+static void emui_focus_check()
 {
-	EMTILE *focused_child = NULL;
+	// if the focused tile is hidden after geometry change,
+	// and there is no scroll handler in tile's focus group,
+	// search for a new unhidden tile:
+	// go up, then left, then from the beggining of focus group
+	EMTILE *f = emui_focus_get();
+	if (f && (f->properties & P_HIDDEN)) {
+		if (f->fg->drv->scroll_handler) {
+			// TODO: ???
+		} else {
+			EDBG(f, 0, "Tile is hidden after geometry change, moving focus");
+			f = emtile_get_physical_neighbour(f->fg, FC_ABOVE, P_INTERACTIVE, P_HIDDEN);
+			if (f->properties & P_HIDDEN) {
+				f = emtile_get_physical_neighbour(f->fg, FC_LEFT, P_INTERACTIVE, P_HIDDEN);
+				if (f->properties & P_HIDDEN) {
+					f = emtile_get_list_neighbour(f->fg, FC_FIRST, P_INTERACTIVE, P_HIDDEN);
+				}
+			}
+			emui_focus(f);
+		}
+	}
+}
+
+// -----------------------------------------------------------------------
+static void emui_fit(EMTILE *t)
+{
+	EDBG(t, 0, "Tile geometry changed");
+	emtile_fit(t);
+	emui_focus_check();
+}
 
-	// physically delete tile marked P_DELETED
-	if (t->properties & P_DELETED) {
-		_emtile_really_delete(t);
-		return;
+// -----------------------------------------------------------------------
+static void emui_fit_tree(EMTILE *t)
+{
+	int geometry_changed = t->geometry_changed;
+
+	if (geometry_changed) {
+		emui_fit(t);
 	}
 
+	struct emtile_visit v;
+	for (EMTILE *child=_emtile_visit_first(t, &v) ; child ; child=_emtile_visit_next(&v)) {
+		// refit only children whose layout inputs have changed
+		if (geometry_changed && emtile_fit_needed(child)) {
+			child->geometry_changed = 1;
+		}
+		emui_fit_tree(child);
+	}
+}
+
+// -----------------------------------------------------------------------
+static void emui_layout_tree(EMTILE *t)
+{
+	// large trees are laid out in parallel, if possible
+	if (emui_lpool_layout(t, emui_fit_tree) == E_OK) {
+		emui_focus_check();
+	} else {
+		emui_fit_tree(t);
+	}
+}
+
+// -----------------------------------------------------------------------
+void emui_layout_threads(int threads)
+{
+	// 0 = one thread per CPU, 1 = always lay out serially
+	emui_lpool_threads(threads);
+}
+
+// -----------------------------------------------------------------------
+void emui_batch_begin()
+{
+	// tiles created within a batch are not laid out until the (outermost)
+	// batch is committed - their geometry and visibility aren't known
+	// until then. Windows are created later, for tiles that get drawn.
+	_emtile_defer_fit(1);
+}
+
+// -----------------------------------------------------------------------
+void emui_batch_commit()
+{
+	if (_emtile_defer_fit(0) || !layout) return;
+
+	// lay out everything built in the batch at once,
+	// including tiles that containers create while being laid out
+	_emtile_defer_fit(1);
+	emui_layout_tree(layout);
+	_emtile_defer_fit(0);
+}
+
+// -----------------------------------------------------------------------
+static void emui_draw_layer(EMTILE *t, int touch, int layer)
+{
+	EMTILE *focused_child = NULL;
+
+	// remember drawing order for mouse hit tests
+	t->draw_seq = ++draw_seq;
+
 	// update tile geometry
 	int geometry_changed = t->geometry_changed;
 	if (geometry_changed) {
-		EDBG(t, 0, "Tile geometry changed");
-		emtile_fit(t);
-
-		// if the focused tile is hidden after geometry change,
-		// and there is no scroll handler in tile's focus group,
-		// search for a new unhidden tile:
-		// go up, then left, then from the beggining of focus group
-		EMTILE *f = emui_focus_get();
-		if (f->properties & P_HIDDEN) {
-			if (f->fg->drv->scroll_handler) {
-				// TODO: ???
-			} else {
-				EDBG(f, 0, "Tile is hidden after geometry change, moving focus");
-				f = emtile_get_physical_neighbour(f->fg, FC_ABOVE, P_INTERACTIVE, P_HIDDEN);
-				if (f->properties & P_HIDDEN) {
-					f = emtile_get_physical_neighbour(f->fg, FC_LEFT, P_INTERACTIVE, P_HIDDEN);
-					if (f->properties & P_HIDDEN) {
-						f = emtile_get_list_neighbour(f->fg, FC_FIRST, P_INTERACTIVE, P_HIDDEN);
-					}
-				}
-				emui_focus(f);
-			}
+		emui_fit(t);
+	}
+
+	// window has been cleared by the fit (now or when a batch was committed)
+	int erased = t->erased;
+	t->erased = 0;
+
+	// skip tiles completely covered by a higher layer
+	int occluded = !(t->properties & (P_HIDDEN | P_NOCANVAS)) && emui_compose_tile(t, layer);
+
+	if (!occluded) {
+		// window of a tile below has been erased, or the tile has been covered,
+		// whole window needs to be copied to the screen again
+		if (!erased && (touch || t->occluded) && t->ncwin && !(t->properties & P_NOCANVAS)) {
+			touchwin(t->ncwin);
 		}
+
+		// draw the tile
+		emtile_draw(t);
 	}
 
-	// draw the tile
-	emtile_draw(t);
+	t->occluded = occluded;
+
+	if (erased) {
+		touch = 1;
+	}
 
 	// draw tile's children
-	EMTILE *child = t->ch_first;
+	struct emtile_visit v;
+	EMTILE *child = _emtile_visit_first(t, &v);
 	while (child) {
-		child->geometry_changed |= geometry_changed;
-		// store focused tile to draw it later
-		if (!emui_has_focus(child)) {
-			emui_draw(child);
-		} else {
-			focused_child = child;
+		// refit only children whose layout inputs have changed
+		if (geometry_changed && emtile_fit_needed(child)) {
+			child->geometry_changed = 1;
+		}
+		// skip whole subtrees that are hidden and have nothing to do
+		if ((child->properties & P_HIDDEN) && !child->geometry_changed && emui_tiletab_subtree_idle(child)) {
+			child = _emtile_visit_next(&v);
+			continue;
+		}
+		// subtrees in higher layers are drawn later, on top
+		int child_layer = emui_compose_layer(child, layer);
+		if ((child_layer == layer) || (emui_compose_defer(child, child_layer, touch) != E_OK)) {
+			// store focused tile to draw it later
+			if (!emui_has_focus(child)) {
+				emui_draw_layer(child, touch, child_layer);
+			} else {
+				focused_child = child;
+			}
 		}
-		child = child->ch_next;
+		child = _emtile_visit_next(&v);
 	}
 
-	// draw focused tile last, so it's always on top
+	// within a layer, draw focused tile last, so it's on top of its siblings
 	if (focused_child) {
-		emui_draw(focused_child);
+		emui_draw_layer(focused_child, touch, emui_compose_layer(focused_child, layer));
 	}
 }
 
+// -----------------------------------------------------------------------
+static void emui_draw(EMTILE *t, int touch)
+{
+	int layer;
+
+	emui_compose_begin();
+
+	emui_draw_layer(t, touch, emui_compose_layer(t, Z_BASE));
+	while (emui_compose_next(&t, &layer, &touch)) {
+		emui_draw_layer(t, touch, layer);
+	}
+
+	// edit cursor belongs to the focused tile
+	_emtile_place_cursor(emui_focus_get());
+}
+
 // -----------------------------------------------------------------------
 static int emui_process_event(struct emui_event *ev)
 {
-	EMTILE *t = emui_focus_get();
+	// mouse events go to the tile under the pointer
+	if (ev->type == EV_MOUSE) {
+		return emui_mouse_event(ev);
+	}
 
-	while (t) {
-		if (emtile_event(t, ev) == E_HANDLED) {
-			return E_HANDLED;
-		}
-		t = t->parent;
+	if (emui_dispatch(ev) == E_HANDLED) {
+		return E_HANDLED;
 	}
 
 	// TODO: temporary
 	if ((ev->type == EV_KEY) && (ev->sender == 'q')) {
-		struct emui_event *ev = malloc(sizeof(struct emui_event));
+		struct emui_event *ev = calloc(1, sizeof(struct emui_event));
 		ev->type = EV_QUIT;
 		emui_evq_prepend(ev);
 		return E_HANDLED;
@@ -233,12 +382,24 @@ static void emui_update_screen(struct timeval *ft, unsigned fps)
 		}
 	}
 
+	emtile_delete_queued();
+	emui_tiletab_sync(layout);
+
+	// reuse layout from the last time terminal had this size,
+	// or lay everything out again
+	int restored = 0;
 	if (terminal_resized) {
 		terminal_resized = 0;
-		layout->geometry_changed = 1;
+		emui_lcache_store(layout);
+		restored = emui_lcache_apply(layout);
+		if (!restored) {
+			layout->geometry_changed = 1;
+			emui_layout_tree(layout);
+		}
 	}
 
-	emui_draw(layout);
+	// restored windows need to be copied to the (cleared) screen
+	emui_draw(layout, restored ? 1 : 0);
 	doupdate();
 	frame_current++;
 
@@ -283,12 +444,16 @@ process_event:
 
 		if (ev) {
 			if (ev->type == EV_QUIT) {
-				free(ev);
+				emui_event_free(ev);
 				EDBG(layout, 0, "QUIT");
 				break;
+			} else if (ev->type == EV_RESIZE) {
+				// refit the layout with next screen update
+				terminal_resized = 1;
+				emui_event_free(ev);
 			} else {
 				emui_process_event(ev);
-				free(ev);
+				emui_event_free(ev);
 			}
 		} else {
 			// get another event (or wait ft.tv_usec)
@@ -19,58 +19,130 @@
 
 #include "event.h"
 
+// Events are queued in separate queues for each priority class.
+// Most urgent non-empty queue is always served first, except
+// for notification and background queues, which get an event
+// through once in a while, so they don't starve under constant
+// user input. Control and resize events are never delayed.
+
+#define EVQ_STARVATION_LIMIT 64
+
 struct event_elem {
 	struct emui_event *ev;
 	struct event_elem *next;
 };
 
-static struct event_elem *evq_head;
-static struct event_elem *evq_tail;
+struct event_queue {
+	struct event_elem *head;
+	struct event_elem *tail;
+	unsigned skipped;		// how many times more urgent queue was served instead
+};
+
+static struct event_queue evq[EP_COUNT];
 
 // -----------------------------------------------------------------------
-struct emui_event * emui_evq_get()
+static int _evq_prio(struct emui_event *ev)
+{
+	switch (ev->type) {
+		case EV_QUIT:
+		case EV_ERROR:
+			return EP_CONTROL;
+		case EV_RESIZE:
+			return EP_RESIZE;
+		case EV_KEY:
+		case EV_MOUSE:
+		case EV_PASTE:
+			return EP_INPUT;
+		default:
+			return EP_NOTIFY;
+	}
+}
+
+// -----------------------------------------------------------------------
+static struct emui_event * _evq_take(struct event_queue *q)
 {
 	struct emui_event *ev = NULL;
 	struct event_elem *eve;
 
-	if (evq_head) {
-		ev = evq_head->ev;
-		eve = evq_head;
-		evq_head = evq_head->next;
+	if (q->head) {
+		ev = q->head->ev;
+		eve = q->head;
+		q->head = q->head->next;
 		free(eve);
 	}
 
-	if (!evq_head) {
-		evq_tail = NULL;
+	if (!q->head) {
+		q->tail = NULL;
 	}
 
 	return ev;
 }
 
 // -----------------------------------------------------------------------
-int emui_evq_prepend(struct emui_event *ev)
+struct emui_event * emui_evq_get()
 {
+	int prio;
+
+	// find the most urgent non-empty queue
+	for (prio=0 ; prio<EP_COUNT ; prio++) {
+		if (evq[prio].head) break;
+	}
+
+	if (prio >= EP_COUNT) {
+		return NULL;
+	}
+
+	// let the starving low priority event through,
+	// but only when there is no control or resize event waiting
+	if (prio >= EP_INPUT) {
+		for (int p=EP_COUNT-1 ; p>prio ; p--) {
+			if (evq[p].head && (evq[p].skipped >= EVQ_STARVATION_LIMIT)) {
+				prio = p;
+				break;
+			}
+		}
+	}
+
+	for (int p=prio+1 ; p<EP_COUNT ; p++) {
+		if (evq[p].head) {
+			evq[p].skipped++;
+		}
+	}
+	evq[prio].skipped = 0;
+
+	return _evq_take(evq + prio);
+}
+
+// -----------------------------------------------------------------------
+int emui_evq_prepend_prio(struct emui_event *ev, int prio)
+{
+	if ((prio < 0) || (prio >= EP_COUNT)) return -1;
+
+	struct event_queue *q = evq + prio;
 	struct event_elem *eve = malloc(sizeof(struct event_elem));
 
 	if (!eve) return -1;
 
 	eve->ev = ev;
 
-	if (evq_head) {
-		eve->next = evq_head;
+	if (q->head) {
+		eve->next = q->head;
 	} else {
 		eve->next = NULL;
-		evq_tail = eve;
+		q->tail = eve;
 	}
 
-	evq_head = eve;
+	q->head = eve;
 
 	return 0;
 }
 
 // -----------------------------------------------------------------------
-int emui_evq_append(struct emui_event *ev)
+int emui_evq_append_prio(struct emui_event *ev, int prio)
 {
+	if ((prio < 0) || (prio >= EP_COUNT)) return -1;
+
+	struct event_queue *q = evq + prio;
 	struct event_elem *eve = malloc(sizeof(struct event_elem));
 
 	if (!eve) return -1;
@@ -78,27 +150,50 @@ int emui_evq_append(struct emui_event *ev)
 	eve->ev = ev;
 	eve->next = NULL;
 
-	if (evq_tail) {
-		evq_tail->next = eve;
+	if (q->tail) {
+		q->tail->next = eve;
 	} else {
-		evq_head = eve;
+		q->head = eve;
 	}
 
-	evq_tail = eve;
+	q->tail = eve;
 
 	return 0;
 }
 
+// -----------------------------------------------------------------------
+int emui_evq_prepend(struct emui_event *ev)
+{
+	return emui_evq_prepend_prio(ev, _evq_prio(ev));
+}
+
+// -----------------------------------------------------------------------
+int emui_evq_append(struct emui_event *ev)
+{
+	return emui_evq_append_prio(ev, _evq_prio(ev));
+}
+
 // -----------------------------------------------------------------------
 void emui_evq_clear()
 {
 	struct emui_event *ev;
 
-	do {
-		ev = emui_evq_get();
-		free(ev);
-	} while (ev);
+	for (int prio=0 ; prio<EP_COUNT ; prio++) {
+		do {
+			ev = _evq_take(evq + prio);
+			emui_event_free(ev);
+		} while (ev);
+		evq[prio].skipped = 0;
+	}
+}
+
+// -----------------------------------------------------------------------
+void emui_event_free(struct emui_event *ev)
+{
+	if (!ev) return;
 
+	free(ev->data);
+	free(ev);
 }
 
 // vim: tabstop=4 shiftwidth=4 autoindent
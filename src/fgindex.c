@@ -0,0 +1,383 @@
+//  Copyright (c) 2015 Jakub Filipowicz <jakubf@gmail.com>
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc.,
+//  51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "dbg.h"
+#include "tile.h"
+#include "focus.h"
+#include "fgindex.h"
+
+// Focus group index keeps group members in two interval trees, one
+// for each axis. Moving up or down, only members that overlap the current
+// tile horizontally may be picked. Same goes for moving left or right
+// and members overlapping it vertically.
+//
+// Each tree is a treap ordered by where members start on the axis, with
+// every node knowing how far members in its subtree reach. Queries skip
+// subtrees that end before the band or start after it, so finding
+// k members costs O((k+1) log n), however long any other member is.
+//
+// Members that have been laid out again, joined or left the group are
+// moved in (or out of) the trees in O(log n). Index is built from scratch
+// on the first query, when it ran out of memory, or when it's mostly
+// made of members that have left.
+
+#define FGI_MIN_REBUILD 64
+
+struct fgi_node {
+	EMTILE *t;
+	int b, len;			// member's extent on the axis, as indexed
+	unsigned prio;
+	int l, r;			// subtrees (-1 = none)
+	int reach;			// furthest end within the subtree
+};
+
+struct fgi_axis {
+	struct fgi_node *n;	// indexed by member's fg_ord
+	int root;
+};
+
+struct emui_fgindex {
+	int dirty;
+	struct fgi_axis x;
+	struct fgi_axis y;
+	EMTILE **cand;
+	int count;			// nodes used, including ones of members that left
+	int live;			// members in the trees
+	int size;
+	unsigned seed;
+};
+
+// -----------------------------------------------------------------------
+static int _cmp_ord(const void *a, const void *b)
+{
+	EMTILE * const *t1 = a;
+	EMTILE * const *t2 = b;
+
+	return (*t1)->fg_ord - (*t2)->fg_ord;
+}
+
+// -----------------------------------------------------------------------
+static inline int _less(struct fgi_node *n, int i, int j)
+{
+	// members starting at the same position are kept in group order
+	if (n[i].b != n[j].b) return n[i].b < n[j].b;
+	return i < j;
+}
+
+// -----------------------------------------------------------------------
+static inline void _pull(struct fgi_node *n, int i)
+{
+	int reach = n[i].b + n[i].len;
+
+	if ((n[i].l >= 0) && (n[n[i].l].reach > reach)) reach = n[n[i].l].reach;
+	if ((n[i].r >= 0) && (n[n[i].r].reach > reach)) reach = n[n[i].r].reach;
+
+	n[i].reach = reach;
+}
+
+// -----------------------------------------------------------------------
+static void _split(struct fgi_node *n, int root, int i, int *l, int *r)
+{
+	// l gets nodes ordered before i, r gets the rest
+	if (root < 0) {
+		*l = *r = -1;
+		return;
+	}
+
+	if (_less(n, root, i)) {
+		_split(n, n[root].r, i, &n[root].r, r);
+		*l = root;
+	} else {
+		_split(n, n[root].l, i, l, &n[root].l);
+		*r = root;
+	}
+
+	_pull(n, root);
+}
+
+// -----------------------------------------------------------------------
+static int _merge(struct fgi_node *n, int l, int r)
+{
+	if (l < 0) return r;
+	if (r < 0) return l;
+
+	if (n[l].prio > n[r].prio) {
+		n[l].r = _merge(n, n[l].r, r);
+		_pull(n, l);
+		return l;
+	} else {
+		n[r].l = _merge(n, l, n[r].l);
+		_pull(n, r);
+		return r;
+	}
+}
+
+// -----------------------------------------------------------------------
+static int _insert(struct fgi_node *n, int root, int i)
+{
+	if ((root < 0) || (n[i].prio > n[root].prio)) {
+		_split(n, root, i, &n[i].l, &n[i].r);
+		_pull(n, i);
+		return i;
+	}
+
+	if (_less(n, i, root)) {
+		n[root].l = _insert(n, n[root].l, i);
+	} else {
+		n[root].r = _insert(n, n[root].r, i);
+	}
+	_pull(n, root);
+
+	return root;
+}
+
+// -----------------------------------------------------------------------
+static int _erase(struct fgi_node *n, int root, int i)
+{
+	if (root < 0) return -1;
+
+	if (root == i) {
+		return _merge(n, n[i].l, n[i].r);
+	}
+
+	if (_less(n, i, root)) {
+		n[root].l = _erase(n, n[root].l, i);
+	} else {
+		n[root].r = _erase(n, n[root].r, i);
+	}
+	_pull(n, root);
+
+	return root;
+}
+
+// -----------------------------------------------------------------------
+static void _axis_add(struct fgi_axis *a, int i, EMTILE *t, int b, int len, unsigned prio)
+{
+	a->n[i].t = t;
+	a->n[i].b = b;
+	a->n[i].len = len;
+	a->n[i].prio = prio;
+	a->root = _insert(a->n, a->root, i);
+}
+
+// -----------------------------------------------------------------------
+static void _axis_move(struct fgi_axis *a, int i, int b, int len)
+{
+	if ((a->n[i].b == b) && (a->n[i].len == len)) return;
+
+	// key has to match the one node was inserted with
+	a->root = _erase(a->n, a->root, i);
+	a->n[i].b = b;
+	a->n[i].len = len;
+	a->root = _insert(a->n, a->root, i);
+}
+
+// -----------------------------------------------------------------------
+static void _axis_collect(struct fgi_node *n, int i, int b, int e, EMTILE **cand, int *count)
+{
+	// members that start before the band end, and end after it starts
+	while ((i >= 0) && (n[i].reach > b)) {
+		_axis_collect(n, n[i].l, b, e, cand, count);
+		if (n[i].b >= e) break;
+		if (n[i].b + n[i].len > b) {
+			cand[(*count)++] = n[i].t;
+		}
+		i = n[i].r;
+	}
+}
+
+// -----------------------------------------------------------------------
+static int _fgindex_grow(struct emui_fgindex *idx, int count)
+{
+	if (count <= idx->size) return E_OK;
+
+	int size = idx->size ? idx->size : 16;
+	while (size < count) size *= 2;
+
+	struct fgi_node *xn = realloc(idx->x.n, size * sizeof(struct fgi_node));
+	if (!xn) return E_ALLOC;
+	idx->x.n = xn;
+	struct fgi_node *yn = realloc(idx->y.n, size * sizeof(struct fgi_node));
+	if (!yn) return E_ALLOC;
+	idx->y.n = yn;
+	EMTILE **cand = realloc(idx->cand, size * sizeof(EMTILE *));
+	if (!cand) return E_ALLOC;
+	idx->cand = cand;
+
+	idx->size = size;
+
+	return E_OK;
+}
+
+// -----------------------------------------------------------------------
+static void _fgindex_add(struct emui_fgindex *idx, EMTILE *t)
+{
+	// xorshift, priorities only need to look random
+	idx->seed ^= idx->seed << 13;
+	idx->seed ^= idx->seed >> 17;
+	idx->seed ^= idx->seed << 5;
+
+	t->fg_ord = idx->count++;
+	_axis_add(&idx->x, t->fg_ord, t, t->i.x, t->i.w, idx->seed);
+	_axis_add(&idx->y, t->fg_ord, t, t->i.y, t->i.h, idx->seed);
+	idx->live++;
+}
+
+// -----------------------------------------------------------------------
+static int _fgindex_build(EMTILE *fg, struct emui_fgindex *idx)
+{
+	int count = 0;
+
+	for (EMTILE *f=fg->fg_first ; f ; f=f->fg_next) {
+		count++;
+	}
+
+	if (_fgindex_grow(idx, count) != E_OK) {
+		return E_ALLOC;
+	}
+
+	idx->count = idx->live = 0;
+	idx->x.root = idx->y.root = -1;
+	for (EMTILE *f=fg->fg_first ; f ; f=f->fg_next) {
+		_fgindex_add(idx, f);
+	}
+
+	idx->dirty = 0;
+
+	EDBG(fg, 3, "focus group index rebuilt: %i members", count);
+
+	return E_OK;
+}
+
+// -----------------------------------------------------------------------
+static struct emui_fgindex * _fgindex_valid(EMTILE *fg)
+{
+	if (!fg || !fg->fg_index || fg->fg_index->dirty) {
+		return NULL;
+	}
+
+	return fg->fg_index;
+}
+
+// -----------------------------------------------------------------------
+void emui_fgindex_invalidate(EMTILE *fg)
+{
+	if (fg && fg->fg_index) {
+		fg->fg_index->dirty = 1;
+	}
+}
+
+// -----------------------------------------------------------------------
+void emui_fgindex_add(EMTILE *fg, EMTILE *t)
+{
+	struct emui_fgindex *idx = _fgindex_valid(fg);
+
+	if (!idx) return;
+
+	// members are always appended, so node order follows group order
+	if (_fgindex_grow(idx, idx->count + 1) != E_OK) {
+		idx->dirty = 1;
+		return;
+	}
+
+	_fgindex_add(idx, t);
+}
+
+// -----------------------------------------------------------------------
+void emui_fgindex_remove(EMTILE *fg, EMTILE *t)
+{
+	struct emui_fgindex *idx = _fgindex_valid(fg);
+
+	if (!idx) return;
+
+	idx->x.root = _erase(idx->x.n, idx->x.root, t->fg_ord);
+	idx->y.root = _erase(idx->y.n, idx->y.root, t->fg_ord);
+	idx->live--;
+
+	// don't let nodes of members that have left pile up
+	if ((idx->count > FGI_MIN_REBUILD) && (idx->live < idx->count / 2)) {
+		idx->dirty = 1;
+	}
+}
+
+// -----------------------------------------------------------------------
+void emui_fgindex_update(EMTILE *t)
+{
+	struct emui_fgindex *idx = _fgindex_valid(t->fg);
+
+	if (!idx) return;
+
+	_axis_move(&idx->x, t->fg_ord, t->i.x, t->i.w);
+	_axis_move(&idx->y, t->fg_ord, t->i.y, t->i.h);
+}
+
+// -----------------------------------------------------------------------
+int emui_fgindex_query(EMTILE *fg, EMTILE *t, int dir, EMTILE ***cand)
+{
+	struct emui_fgindex *idx = fg->fg_index;
+	int n = 0;
+
+	if (!idx) {
+		idx = calloc(1, sizeof(struct emui_fgindex));
+		if (!idx) return -1;
+		idx->dirty = 1;
+		idx->seed = 2463534242u;
+		fg->fg_index = idx;
+	}
+
+	if (idx->dirty && (_fgindex_build(fg, idx) != E_OK)) {
+		return -1;
+	}
+
+	switch (dir) {
+		case FC_ABOVE:
+		case FC_BELOW:
+			_axis_collect(idx->x.n, idx->x.root, t->i.x, t->i.x + t->i.w, idx->cand, &n);
+			break;
+		case FC_LEFT:
+		case FC_RIGHT:
+			_axis_collect(idx->y.n, idx->y.root, t->i.y, t->i.y + t->i.h, idx->cand, &n);
+			break;
+		default:
+			return -1;
+	}
+
+	// candidates are returned in focus group order
+	qsort(idx->cand, n, sizeof(EMTILE *), _cmp_ord);
+	*cand = idx->cand;
+
+	return n;
+}
+
+// -----------------------------------------------------------------------
+void emui_fgindex_delete(EMTILE *fg)
+{
+	struct emui_fgindex *idx = fg->fg_index;
+
+	if (!idx) return;
+
+	free(idx->x.n);
+	free(idx->y.n);
+	free(idx->cand);
+	free(idx);
+	fg->fg_index = NULL;
+}
+
+// vim: tabstop=4 shiftwidth=4 autoindent
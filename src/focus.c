@@ -22,6 +22,9 @@
 #include "dbg.h"
 #include "tile.h"
 #include "focus.h"
+#include "fgindex.h"
+#include "compose.h"
+#include "keymap.h"
 
 struct focus_item {
 	EMTILE *t;
@@ -31,6 +34,26 @@ struct focus_item {
 struct focus_item *focus_stack;
 static EMTILE *focus;
 
+// Tiles on the focus path are marked with the current focus epoch.
+// Moving focus starts a new epoch, which invalidates all old marks at once.
+static unsigned long focus_epoch;
+
+// Each focus group keeps its members' focus keys hashed.
+// For every key the member that comes first in the focus group list
+// is stored, as that is the one that gets focused on a keypress.
+
+#define FK_BUCKETS 32
+
+struct fk_item {
+	int key;
+	EMTILE *t;
+	struct fk_item *next;
+};
+
+struct emui_fgkeys {
+	struct fk_item *bucket[FK_BUCKETS];
+};
+
 // -----------------------------------------------------------------------
 static void _focus_stack_put(EMTILE *t)
 {
@@ -66,23 +89,19 @@ static void _focus_stack_put(EMTILE *t)
 }
 
 // -----------------------------------------------------------------------
-void emui_focus_stack_delete_tile(EMTILE *t)
+void emui_focus_stack_purge()
 {
-	struct focus_item *fi = focus_stack;
-	struct focus_item *next = NULL;
-
-	while (fi) {
-		if (fi->t == t) {
-			if (next) {
-				next->prev = fi->prev;
-			} else {
-				focus_stack = fi->prev;
-			}
-			free(fi);
-			return;
+	struct focus_item **fi = &focus_stack;
+
+	// remove all tiles that are about to be deleted
+	while (*fi) {
+		if ((*fi)->t->properties & P_DELETED) {
+			struct focus_item *prev = (*fi)->prev;
+			free(*fi);
+			*fi = prev;
+		} else {
+			fi = &(*fi)->prev;
 		}
-		next = fi;
-		fi = fi->prev;
 	}
 }
 
@@ -128,10 +147,18 @@ static EMTILE * _focus_down(EMTILE *t)
 // -----------------------------------------------------------------------
 static void _focus_up(EMTILE *t)
 {
+	// key sequence started in one tile doesn't complete in another
+	if (t != focus) {
+		emkeymap_reset_pending();
+	}
+
 	// set new focus path
 	focus = t;
+	focus_epoch++;
+	if (t) t->focus_epoch = focus_epoch;
 	while (t && t->parent) {
 		t->parent->focus = t;
+		t->parent->focus_epoch = focus_epoch;
 		t = t->parent;
 	}
 }
@@ -157,12 +184,14 @@ void emui_focus(EMTILE *t)
 		// unfloat previously floating tile
 		if (last_float) {
 			last_float->properties &= ~P_FLOAT;
+			emui_compose_track(last_float);
 			emtile_set_geometry_parent(last_float, last_float->parent, GEOM_INTERNAL);
 			emtile_geometry_changed(last_float);
 		}
 		// float hidden tile
 		if (t->properties & P_HIDDEN) {
 			t->properties |= P_FLOAT;
+			emui_compose_track(t);
 			emtile_set_geometry_parent(t, emui_get_layout(), GEOM_INTERNAL);
 			emtile_geometry_changed(t);
 			last_float = t;
@@ -193,12 +222,13 @@ int emui_is_focused(EMTILE *t)
 // -----------------------------------------------------------------------
 int emui_has_focus(EMTILE *t)
 {
-	EMTILE *f = focus;
-	while (f) {
-		if (t == f) return 1;
-		f = f->parent;
-	}
-	return 0;
+	return focus && (t->focus_epoch == focus_epoch);
+}
+
+// -----------------------------------------------------------------------
+unsigned long emui_focus_epoch_get()
+{
+	return focus_epoch;
 }
 
 // -----------------------------------------------------------------------
@@ -216,6 +246,124 @@ EMTILE * emui_focus_get()
 	return focus;
 }
 
+// -----------------------------------------------------------------------
+static struct fk_item ** _fk_find(EMTILE *fg, int key)
+{
+	struct fk_item **fki = &fg->fg_keys->bucket[(unsigned) key % FK_BUCKETS];
+
+	while (*fki && ((*fki)->key != key)) {
+		fki = &(*fki)->next;
+	}
+
+	return fki;
+}
+
+// -----------------------------------------------------------------------
+static int _fk_precedes(EMTILE *t1, EMTILE *t2)
+{
+	while (t1) {
+		if (t1 == t2) return 1;
+		t1 = t1->fg_next;
+	}
+
+	return 0;
+}
+
+// -----------------------------------------------------------------------
+static int _fk_add(EMTILE *t)
+{
+	EMTILE *fg = t->fg;
+
+	if (!fg || !t->key) return E_OK;
+
+	if (!fg->fg_keys) {
+		fg->fg_keys = calloc(1, sizeof(struct emui_fgkeys));
+		if (!fg->fg_keys) return E_ALLOC;
+	}
+
+	struct fk_item **fki = _fk_find(fg, t->key);
+
+	// key is already used within the focus group
+	if (*fki) {
+		if ((*fki)->t == t) return E_OK;
+		EDBG(t, 1, "Focus key %c already used in the focus group", t->key);
+		if (_fk_precedes(t, (*fki)->t)) {
+			(*fki)->t = t;
+		}
+		return E_CONFLICT;
+	}
+
+	struct fk_item *nfki = malloc(sizeof(struct fk_item));
+	if (!nfki) return E_ALLOC;
+	nfki->key = t->key;
+	nfki->t = t;
+	nfki->next = NULL;
+	*fki = nfki;
+
+	return E_OK;
+}
+
+// -----------------------------------------------------------------------
+static void _fk_remove(EMTILE *t)
+{
+	EMTILE *fg = t->fg;
+
+	if (!fg || !fg->fg_keys || !t->key) return;
+
+	struct fk_item **fki = _fk_find(fg, t->key);
+
+	if (!*fki || ((*fki)->t != t)) return;
+
+	// the key may still be used by another member
+	for (EMTILE *f=fg->fg_first ; f ; f=f->fg_next) {
+		if ((f != t) && (f->key == t->key)) {
+			(*fki)->t = f;
+			return;
+		}
+	}
+
+	struct fk_item *next = (*fki)->next;
+	free(*fki);
+	*fki = next;
+}
+
+// -----------------------------------------------------------------------
+int emui_focus_key_set(EMTILE *t, int key)
+{
+	_fk_remove(t);
+	t->key = key;
+
+	return _fk_add(t);
+}
+
+// -----------------------------------------------------------------------
+EMTILE * emui_focus_key_get(EMTILE *fg, int key)
+{
+	if (!fg->fg_keys || !key) return NULL;
+
+	struct fk_item *fki = *_fk_find(fg, key);
+
+	return fki ? fki->t : NULL;
+}
+
+// -----------------------------------------------------------------------
+void emui_focus_keys_drop(EMTILE *fg)
+{
+	if (!fg->fg_keys) return;
+
+	for (int i=0 ; i<FK_BUCKETS ; i++) {
+		struct fk_item *fki = fg->fg_keys->bucket[i];
+		while (fki) {
+			struct fk_item *next = fki->next;
+			free(fki);
+			fki = next;
+		}
+	}
+
+	free(fg->fg_keys);
+	fg->fg_keys = NULL;
+}
+
 // -----------------------------------------------------------------------
 int emui_focus_group_add(EMTILE *parent, EMTILE *t)
 {
@@ -239,6 +387,8 @@ int emui_focus_group_add(EMTILE *parent, EMTILE *t)
 			fg->fg_first = t;
 		}
 		fg->fg_last = t;
+		emui_fgindex_add(fg, t);
+		_fk_add(t);
 	}
 
 	return 0;
@@ -253,6 +403,9 @@ void emui_focus_group_unlink(EMTILE *t)
 
 	if (!fg) return;
 
+	_fk_remove(t);
+	emui_fgindex_remove(fg, t);
+
 	if (t->fg_prev) {
 		t->fg_prev->fg_next = t->fg_next;
 	}
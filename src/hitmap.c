@@ -0,0 +1,222 @@
+//  Copyright (c) 2015 Jakub Filipowicz <jakubf@gmail.com>
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc.,
+//  51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+
+#include <stdlib.h>
+
+#include "dbg.h"
+#include "tile.h"
+#include "hitmap.h"
+
+// Hit map is a uniform grid of buckets laid over the screen.
+// Each bucket lists all visible tiles whose external area
+// intersects with it, so finding a tile under the pointer
+// requires looking only at tiles in a single bucket.
+
+#define HM_CELL_W 8
+#define HM_CELL_H 4
+
+struct hm_bucket {
+	EMTILE **t;
+	int count;
+	int size;
+};
+
+static struct hm_bucket *hm;
+static int hm_w, hm_h;
+
+// -----------------------------------------------------------------------
+static int _bucket_add(struct hm_bucket *b, EMTILE *t)
+{
+	if (b->count >= b->size) {
+		int size = b->size ? b->size * 2 : 8;
+		EMTILE **nt = realloc(b->t, size * sizeof(EMTILE *));
+		if (!nt) return E_ALLOC;
+		b->t = nt;
+		b->size = size;
+	}
+
+	b->t[b->count++] = t;
+
+	return E_OK;
+}
+
+// -----------------------------------------------------------------------
+static void _bucket_del(struct hm_bucket *b, EMTILE *t)
+{
+	for (int i=0 ; i<b->count ; i++) {
+		if (b->t[i] == t) {
+			b->t[i] = b->t[--b->count];
+			return;
+		}
+	}
+}
+
+// -----------------------------------------------------------------------
+static int _range(struct emui_geom *g, int *bx1, int *by1, int *bx2, int *by2)
+{
+	if ((g->w <= 0) || (g->h <= 0) || (g->x + g->w <= 0) || (g->y + g->h <= 0)) {
+		return 0;
+	}
+
+	*bx1 = g->x > 0 ? g->x / HM_CELL_W : 0;
+	*by1 = g->y > 0 ? g->y / HM_CELL_H : 0;
+	*bx2 = (g->x + g->w - 1) / HM_CELL_W;
+	*by2 = (g->y + g->h - 1) / HM_CELL_H;
+
+	if (*bx2 >= hm_w) *bx2 = hm_w - 1;
+	if (*by2 >= hm_h) *by2 = hm_h - 1;
+
+	return (*bx1 <= *bx2) && (*by1 <= *by2);
+}
+
+// -----------------------------------------------------------------------
+static void _add(EMTILE *t)
+{
+	int bx1, by1, bx2, by2;
+
+	if (_range(&t->hm, &bx1, &by1, &bx2, &by2)) {
+		for (int y=by1 ; y<=by2 ; y++) {
+			for (int x=bx1 ; x<=bx2 ; x++) {
+				if (_bucket_add(hm + y*hm_w + x, t) != E_OK) {
+					EDBG(t, 1, "cannot add tile to the hit map");
+				}
+			}
+		}
+	}
+}
+
+// -----------------------------------------------------------------------
+static void _reindex(EMTILE *t)
+{
+	if (t->hm_indexed) {
+		_add(t);
+	}
+
+	for (EMTILE *ch=t->ch_first ; ch ; ch=ch->ch_next) {
+		_reindex(ch);
+	}
+}
+
+// -----------------------------------------------------------------------
+int emui_hitmap_resize(EMTILE *root, int w, int h)
+{
+	int nw = (w + HM_CELL_W - 1) / HM_CELL_W;
+	int nh = (h + HM_CELL_H - 1) / HM_CELL_H;
+
+	if (hm && (nw == hm_w) && (nh == hm_h)) {
+		return E_OK;
+	}
+
+	struct hm_bucket *nhm = calloc(nw * nh, sizeof(struct hm_bucket));
+	if (!nhm) return E_ALLOC;
+
+	for (int i=0 ; i<hm_w*hm_h ; i++) {
+		free(hm[i].t);
+	}
+	free(hm);
+	hm = nhm;
+	hm_w = nw;
+	hm_h = nh;
+
+	// Index all tiles again. Tiles that don't move during the resize
+	// keep their geometry, and wouldn't be added to buckets that
+	// were cut off by the old screen size otherwise
+	_reindex(root);
+
+	return E_OK;
+}
+
+// -----------------------------------------------------------------------
+void emui_hitmap_remove(EMTILE *t)
+{
+	int bx1, by1, bx2, by2;
+
+	if (!t->hm_indexed) return;
+
+	if (_range(&t->hm, &bx1, &by1, &bx2, &by2)) {
+		for (int y=by1 ; y<=by2 ; y++) {
+			for (int x=bx1 ; x<=bx2 ; x++) {
+				_bucket_del(hm + y*hm_w + x, t);
+			}
+		}
+	}
+
+	t->hm_indexed = 0;
+}
+
+// -----------------------------------------------------------------------
+void emui_hitmap_update(EMTILE *t)
+{
+	int visible = !(t->properties & (P_HIDDEN | P_DELETED));
+
+	if (!hm) return;
+
+	if (t->hm_indexed) {
+		// nothing moved, nothing to do
+		if (visible && (t->hm.x == t->e.x) && (t->hm.y == t->e.y) && (t->hm.w == t->e.w) && (t->hm.h == t->e.h)) {
+			return;
+		}
+		emui_hitmap_remove(t);
+	}
+
+	if (!visible) return;
+
+	t->hm = t->e;
+	t->hm_indexed = 1;
+
+	_add(t);
+}
+
+// -----------------------------------------------------------------------
+EMTILE * emui_hitmap_get(int x, int y)
+{
+	EMTILE *top = NULL;
+
+	if (!hm || (x < 0) || (y < 0)) return NULL;
+
+	int bx = x / HM_CELL_W;
+	int by = y / HM_CELL_H;
+
+	if ((bx >= hm_w) || (by >= hm_h)) return NULL;
+
+	struct hm_bucket *b = hm + by*hm_w + bx;
+
+	// find the tile that was drawn last (is on top) at given position
+	for (int i=0 ; i<b->count ; i++) {
+		EMTILE *t = b->t[i];
+		if (t->properties & (P_HIDDEN | P_DELETED)) continue;
+		if ((x < t->e.x) || (x >= t->e.x + t->e.w) || (y < t->e.y) || (y >= t->e.y + t->e.h)) continue;
+		if (!top || (t->draw_seq > top->draw_seq)) {
+			top = t;
+		}
+	}
+
+	return top;
+}
+
+// -----------------------------------------------------------------------
+void emui_hitmap_destroy()
+{
+	for (int i=0 ; i<hm_w*hm_h ; i++) {
+		free(hm[i].t);
+	}
+	free(hm);
+	hm = NULL;
+	hm_w = hm_h = 0;
+}
+
+// vim: tabstop=4 shiftwidth=4 autoindent
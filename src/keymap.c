@@ -0,0 +1,447 @@
+//  Copyright (c) 2015 Jakub Filipowicz <jakubf@gmail.com>
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc.,
+//  51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+
+
+#include <stdlib.h>
+#include <string.h>
+#include <ncurses.h>
+#include <term.h>
+
+#include "dbg.h"
+#include "tile.h"
+#include "keymap.h"
+#include "connect.h"
+
+// Key bindings are compiled into a trie. Trie edges (node, key) -> child
+// are stored in a single open addressing hash table, so matching
+// a keypress is one lookup, no matter how many bindings there are.
+// Node 0 is the root, matching state is the current node.
+//
+// Only one keymap can be in the middle of a sequence at a time
+// (a key that an inner keymap waits for never reaches outer ones).
+// It is remembered, so that the sequence can be dropped when focus moves.
+
+#define KM_MIN_NODES 16
+#define KM_MIN_EDGES 32
+#define KM_MAX_SEQ 8
+
+struct km_node {
+	emui_int_f_int handler;
+	int arg;
+	int children;
+};
+
+struct km_edge {
+	int node;
+	int key;
+	int child;
+};
+
+struct emui_keymap {
+	struct km_node *nodes;
+	int nodes_count;
+	int nodes_size;
+	struct km_edge *edges;
+	int edges_count;
+	int edges_size;
+	int state;
+};
+
+static EMKEYMAP *km_pending;
+
+struct key_name {
+	char *name;
+	int code;
+};
+
+static struct key_name key_names[] = {
+	{ "Up",			KEY_UP },
+	{ "Down",		KEY_DOWN },
+	{ "Left",		KEY_LEFT },
+	{ "Right",		KEY_RIGHT },
+	{ "PgUp",		KEY_PPAGE },
+	{ "PgDn",		KEY_NPAGE },
+	{ "Home",		KEY_HOME },
+	{ "End",		KEY_END },
+	{ "Ins",		KEY_IC },
+	{ "Del",		KEY_DC },
+	{ "S-Del",		KEY_SDC },
+	{ "Backspace",	KEY_BACKSPACE },
+	{ "Tab",		9 },
+	{ "S-Tab",		KEY_BTAB },
+	{ "Enter",		'\n' },
+	{ "Esc",		27 },
+	{ "Space",		' ' },
+	{ NULL,			0 }
+};
+
+struct key_cap {
+	char *name;
+	char *cap;
+	int code;
+};
+
+// keys without fixed ncurses key codes, resolved using terminfo
+static struct key_cap key_caps[] = {
+	{ "C-PgUp",		"kPRV5",	0 },
+	{ "C-PgDn",		"kNXT5",	0 },
+	{ "C-Up",		"kUP5",		0 },
+	{ "C-Down",		"kDN5",		0 },
+	{ "C-Left",		"kLFT5",	0 },
+	{ "C-Right",	"kRIT5",	0 },
+	{ "C-Home",		"kHOM5",	0 },
+	{ "C-End",		"kEND5",	0 },
+	{ NULL,			NULL,		0 }
+};
+
+// -----------------------------------------------------------------------
+static int _key_cap_code(struct key_cap *k)
+{
+	char *seq;
+
+	if (!k->code) {
+		seq = tigetstr(k->cap);
+		if (seq && (seq != (char *) -1)) {
+			k->code = key_defined(seq);
+		}
+		if (k->code <= 0) {
+			k->code = -1;
+		}
+	}
+
+	return k->code;
+}
+
+// -----------------------------------------------------------------------
+int emui_key_code(char *name)
+{
+	int len = strlen(name);
+
+	// single characters stand for themselves
+	if (len == 1) {
+		return (unsigned char) *name;
+	}
+
+	// function keys
+	if ((name[0] == 'F') && (len <= 3) && (name[1] >= '0') && (name[1] <= '9')) {
+		int f = atoi(name + 1);
+		if ((f > 0) && (f <= 63)) {
+			return KEY_F(f);
+		}
+		return -1;
+	}
+
+	for (struct key_name *k=key_names ; k->name ; k++) {
+		if (!strcmp(k->name, name)) {
+			return k->code;
+		}
+	}
+
+	for (struct key_cap *k=key_caps ; k->name ; k++) {
+		if (!strcmp(k->name, name)) {
+			return _key_cap_code(k);
+		}
+	}
+
+	// ctrl-letter chord
+	if ((len == 3) && (name[0] == 'C') && (name[1] == '-') && (name[2] >= '@') && (name[2] <= '~')) {
+		return name[2] & 0x1f;
+	}
+
+	return -1;
+}
+
+// -----------------------------------------------------------------------
+static unsigned _edge_hash(int node, int key, int size)
+{
+	unsigned h = (unsigned) node * 0x9e3779b1u ^ (unsigned) key * 0x85ebca6bu;
+	h ^= h >> 15;
+	return h & (size - 1);
+}
+
+// -----------------------------------------------------------------------
+static int _edge_get(EMKEYMAP *km, int node, int key)
+{
+	unsigned h = _edge_hash(node, key, km->edges_size);
+
+	while (km->edges[h].node >= 0) {
+		if ((km->edges[h].node == node) && (km->edges[h].key == key)) {
+			return km->edges[h].child;
+		}
+		h = (h + 1) & (km->edges_size - 1);
+	}
+
+	return -1;
+}
+
+// -----------------------------------------------------------------------
+static void _edge_put(struct km_edge *edges, int size, int node, int key, int child)
+{
+	unsigned h = _edge_hash(node, key, size);
+
+	while (edges[h].node >= 0) {
+		h = (h + 1) & (size - 1);
+	}
+
+	edges[h].node = node;
+	edges[h].key = key;
+	edges[h].child = child;
+}
+
+// -----------------------------------------------------------------------
+static struct km_edge * _edges_alloc(int size)
+{
+	struct km_edge *edges = malloc(size * sizeof(struct km_edge));
+	if (!edges) return NULL;
+
+	for (int i=0 ; i<size ; i++) {
+		edges[i].node = -1;
+	}
+
+	return edges;
+}
+
+// -----------------------------------------------------------------------
+static int _edge_add(EMKEYMAP *km, int node, int key, int child)
+{
+	// keep the load factor below 1/2
+	if (2 * (km->edges_count + 1) > km->edges_size) {
+		int size = km->edges_size * 2;
+		struct km_edge *edges = _edges_alloc(size);
+		if (!edges) return E_ALLOC;
+		for (int i=0 ; i<km->edges_size ; i++) {
+			if (km->edges[i].node >= 0) {
+				_edge_put(edges, size, km->edges[i].node, km->edges[i].key, km->edges[i].child);
+			}
+		}
+		free(km->edges);
+		km->edges = edges;
+		km->edges_size = size;
+	}
+
+	_edge_put(km->edges, km->edges_size, node, key, child);
+	km->edges_count++;
+
+	return E_OK;
+}
+
+// -----------------------------------------------------------------------
+static int _node_add(EMKEYMAP *km)
+{
+	if (km->nodes_count >= km->nodes_size) {
+		int size = km->nodes_size * 2;
+		struct km_node *nodes = realloc(km->nodes, size * sizeof(struct km_node));
+		if (!nodes) return -1;
+		km->nodes = nodes;
+		km->nodes_size = size;
+	}
+
+	memset(km->nodes + km->nodes_count, 0, sizeof(struct km_node));
+
+	return km->nodes_count++;
+}
+
+// -----------------------------------------------------------------------
+EMKEYMAP * emkeymap()
+{
+	EMKEYMAP *km = calloc(1, sizeof(EMKEYMAP));
+	if (!km) return NULL;
+
+	km->nodes = calloc(KM_MIN_NODES, sizeof(struct km_node));
+	km->edges = _edges_alloc(KM_MIN_EDGES);
+	if (!km->nodes || !km->edges) {
+		emkeymap_delete(km);
+		return NULL;
+	}
+
+	km->nodes_size = KM_MIN_NODES;
+	km->nodes_count = 1; // root
+	km->edges_size = KM_MIN_EDGES;
+
+	return km;
+}
+
+// -----------------------------------------------------------------------
+void emkeymap_delete(EMKEYMAP *km)
+{
+	if (!km) return;
+
+	if (km == km_pending) {
+		km_pending = NULL;
+	}
+
+	free(km->nodes);
+	free(km->edges);
+	free(km);
+}
+
+// -----------------------------------------------------------------------
+static int _parse_keys(char *keys, int *seq)
+{
+	char *buf = strdup(keys);
+	char *saveptr = NULL;
+	int len = 0;
+
+	if (!buf) return -1;
+
+	char *name = strtok_r(buf, " ", &saveptr);
+	while (name) {
+		if (len >= KM_MAX_SEQ) {
+			len = -1;
+			break;
+		}
+		seq[len] = emui_key_code(name);
+		if (seq[len] < 0) {
+			len = -1;
+			break;
+		}
+		len++;
+		name = strtok_r(NULL, " ", &saveptr);
+	}
+
+	free(buf);
+
+	return len;
+}
+
+// -----------------------------------------------------------------------
+int emkeymap_bind(EMKEYMAP *km, char *keys, emui_int_f_int handler, int arg)
+{
+	int seq[KM_MAX_SEQ];
+	int node = 0;
+	int len = _parse_keys(keys, seq);
+
+	if ((len <= 0) || !handler) {
+		return E_SYNTAX;
+	}
+
+	// check for conflicts first, so the trie stays intact on error
+	for (int i=0 ; i<len ; i++) {
+		node = _edge_get(km, node, seq[i]);
+		if (node < 0) break;
+		// a shorter sequence is already bound
+		if ((i < len-1) && km->nodes[node].handler) {
+			return E_CONFLICT;
+		}
+	}
+	if (node >= 0) {
+		// a longer sequence starts with this one
+		if (km->nodes[node].children) {
+			return E_CONFLICT;
+		}
+		// the same sequence is bound again, rebind it
+		km->nodes[node].handler = handler;
+		km->nodes[node].arg = arg;
+		return E_OK;
+	}
+
+	// add missing nodes
+	node = 0;
+	for (int i=0 ; i<len ; i++) {
+		int child = _edge_get(km, node, seq[i]);
+		if (child < 0) {
+			child = _node_add(km);
+			if ((child < 0) || (_edge_add(km, node, seq[i], child) != E_OK)) {
+				return E_ALLOC;
+			}
+			km->nodes[node].children++;
+		}
+		node = child;
+	}
+
+	km->nodes[node].handler = handler;
+	km->nodes[node].arg = arg;
+
+	return E_OK;
+}
+
+// -----------------------------------------------------------------------
+int emkeymap_load(EMKEYMAP *km, struct emui_keybinding *kb)
+{
+	int failed = 0;
+
+	// keys unknown to the terminal are skipped, the rest is still bound
+	while (kb->keys) {
+		int res = emkeymap_bind(km, kb->keys, kb->handler, kb->arg);
+		if (res != E_OK) {
+			EDBG(NULL, 1, "cannot bind key sequence \"%s\": %i", kb->keys, res);
+			failed++;
+		}
+		kb++;
+	}
+
+	return failed;
+}
+
+// -----------------------------------------------------------------------
+void emkeymap_reset(EMKEYMAP *km)
+{
+	km->state = 0;
+	if (km == km_pending) {
+		km_pending = NULL;
+	}
+}
+
+// -----------------------------------------------------------------------
+void emkeymap_reset_pending()
+{
+	if (km_pending) {
+		emkeymap_reset(km_pending);
+	}
+}
+
+// -----------------------------------------------------------------------
+int emkeymap_feed(EMKEYMAP *km, EMTILE *t, int key)
+{
+	int next = _edge_get(km, km->state, key);
+
+	// sequence broken, start over
+	if ((next < 0) && (km->state != 0)) {
+		emkeymap_reset(km);
+		next = _edge_get(km, 0, key);
+	}
+
+	if (next < 0) {
+		return E_UNHANDLED;
+	}
+
+	struct km_node *n = km->nodes + next;
+
+	// sequence not finished yet, wait for more keys
+	if (n->children) {
+		// sequence pending in another keymap can't be completed anymore
+		if (km_pending && (km_pending != km)) {
+			emkeymap_reset(km_pending);
+		}
+		km->state = next;
+		km_pending = km;
+		return E_HANDLED;
+	}
+
+	emkeymap_reset(km);
+
+	return n->handler(t, n->arg);
+}
+
+// -----------------------------------------------------------------------
+void emtile_set_keymap(EMTILE *t, EMKEYMAP *km)
+{
+	t->keymap = km;
+	emui_dispatch_invalidate();
+}
+
+// vim: tabstop=4 shiftwidth=4 autoindent
@@ -0,0 +1,834 @@
+//  Copyright (c) 2015 Jakub Filipowicz <jakubf@gmail.com>
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc.,
+//  51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "dbg.h"
+#include "tile.h"
+#include "tiles.h"
+#include "style.h"
+#include "focus.h"
+#include "keymap.h"
+#include "layout.h"
+#include "emui.h"
+
+// Layout descriptors let applications build (parts of) the UI from
+// a file instead of a sequence of constructor calls.
+//
+// Text form has one tile per line, nesting is denoted by indentation:
+//
+//   # comment
+//   splitter AL_BOTTOM 10 FIT_DIV2 5
+//       frame 0 0 FIT_FILL FIT_FILL "Registers" P_NONE key=r
+//           label 1 1 4 S_DEFAULT "PC:"
+//           lineedit 5 1 6 6 TT_HEX M_OVR text="0000" name="PC"
+//       flex AL_HORIZONTAL
+//           label 0 0 10 S_DEFAULT "Status" hint=1,0,1,0
+//
+// Each line starts with the tile type followed by constructor arguments
+// (in the same order as for emui_<type>() calls) and optional attributes:
+// name="...", key=<key name>, props=<properties>, text="..." (lineedit
+// only), hint=<min>,<max>,<weight>,<priority> (flex children) and
+// slot=<n> (templates, see below).
+// Integer values may use emui constants joined with '|' or '+'.
+// There is only one top-level tile in a layout.
+//
+// Binary form is what the compiler makes of it: a header, fixed-size
+// node records in tree pre-order and a blob of NUL-terminated strings.
+// It is mapped by the loader and built in a single batch, with all
+// tiles laid out together when it's done. Numbers are stored in native byte order,
+// key names are resolved when loading (key codes depend on the terminal).
+//
+// Templates are layouts compiled in memory, meant to be instantiated
+// many times (rows of a list, for example). Text is parsed only once,
+// and instances are built (and laid out) in one batch.
+// Tiles marked with slot=<n> are handed over to the bind function,
+// so each instance can be filled with its own data.
+
+#define EML_VERSION 2
+#define EML_ARGS 6
+#define EML_DEPTH_MAX 64
+#define EML_SLOTS_MAX 64
+#define EML_TAB 4
+
+struct eml_header {
+	char magic[4];
+	uint32_t version;			// also catches byte order mismatch
+	uint32_t nodes;
+	uint32_t strings_size;
+};
+
+enum eml_flags {
+	EMLF_STR	= 1 << 0,
+	EMLF_NAME	= 1 << 1,
+	EMLF_KEY	= 1 << 2,
+	EMLF_PROPS	= 1 << 3,
+	EMLF_TEXT	= 1 << 4,
+	EMLF_HINT	= 1 << 5,
+	EMLF_SLOT	= 1 << 6,
+};
+
+struct eml_node {
+	uint8_t type;
+	uint8_t flags;
+	uint16_t children;
+	int32_t arg[EML_ARGS];
+	uint32_t str;				// string constructor argument
+	uint32_t name;
+	uint32_t key;
+	uint32_t text;
+	uint32_t props;
+	int16_t hint[4];
+	uint16_t slot;				// template slot the tile is bound to
+	uint16_t reserved;
+};
+
+enum eml_types {
+	EML_DUMMY,
+	EML_FRAME,
+	EML_SPLITTER,
+	EML_TABS,
+	EML_JUSTIFIER,
+	EML_FLEX,
+	EML_GRID,
+	EML_LIST,
+	EML_LABEL,
+	EML_LINEEDIT,
+	EML_LINE,
+	EML_TYPES
+};
+
+struct eml_type {
+	char *name;
+	char *args;					// i - integer, s - string
+	int container;
+};
+
+static const struct eml_type eml_types[EML_TYPES] = {
+	[EML_DUMMY]		= { "dummy",	"iiii",		1 },
+	[EML_FRAME]		= { "frame",	"iiiisi",	1 },
+	[EML_SPLITTER]	= { "splitter",	"iiii",		1 },
+	[EML_TABS]		= { "tabs",		"",			1 },
+	[EML_JUSTIFIER]	= { "justifier","",			1 },
+	[EML_FLEX]		= { "flex",		"i",		1 },
+	[EML_GRID]		= { "grid",		"iiiii",	1 },
+	[EML_LIST]		= { "list",		"",			1 },
+	[EML_LABEL]		= { "label",	"iiiis",	0 },
+	[EML_LINEEDIT]	= { "lineedit",	"iiiiii",	0 },
+	[EML_LINE]		= { "line",		"iiii",		0 },
+};
+
+#define C(x) { #x, x }
+
+static const struct eml_const {
+	char *name;
+	int value;
+} eml_consts[] = {
+	C(TT_TEXT), C(TT_INT), C(TT_HEX), C(TT_OCT), C(TT_BIN),
+	C(M_INS), C(M_OVR),
+	C(FIT_DIV5), C(FIT_DIV4), C(FIT_DIV3), C(FIT_DIV2), C(FIT_FILL),
+	C(AL_LEFT), C(AL_RIGHT), C(AL_TOP), C(AL_BOTTOM), C(AL_CENTER), C(AL_MIDDLE),
+	C(AL_HORIZONTAL), C(AL_VERTICAL),
+	C(P_NONE), C(P_HMAXIMIZE), C(P_VMAXIMIZE), C(P_MAXIMIZE), C(P_VCENTER), C(P_HCENTER),
+	C(P_CENTER), C(P_HFILL), C(P_VFILL), C(P_FLOAT), C(P_FOCUS_GROUP), C(P_INVERSE),
+	C(P_AUTOEDIT),
+	C(S_DEFAULT), C(S_DEBUG), C(S_FRAME_NN), C(S_FRAME_FN), C(S_TITLE_NN), C(S_TITLE_FN),
+	C(S_TAB_NN), C(S_TAB_FN), C(S_EDIT_NN), C(S_TEXT_NN), C(S_TEXT_NI), C(S_TEXT_FN),
+	C(S_TEXT_FI), C(S_TEXT_EN), C(S_TEXT_EI), C(S_FIRST_APP_STYLE),
+	{ NULL, 0 }
+};
+
+#undef C
+
+struct eml_compiler {
+	struct eml_node *nodes;
+	uint32_t count;
+	uint32_t size;
+	char *strings;
+	uint32_t strings_len;
+	uint32_t strings_size;
+	int stack[EML_DEPTH_MAX];
+	int indent[EML_DEPTH_MAX];
+	int depth;
+	int slots;
+};
+
+struct emui_template {
+	struct eml_node *nodes;
+	uint32_t count;
+	char *strings;
+	uint32_t strings_size;
+	int slots;
+};
+
+struct eml_file {
+	const struct eml_node *nodes;
+	uint32_t count;
+	const char *strings;
+	uint32_t strings_size;
+	uint32_t pos;
+};
+
+// -----------------------------------------------------------------------
+static int _eml_string_add(struct eml_compiler *c, char *str, uint32_t *offset)
+{
+	size_t len = strlen(str) + 1;
+
+	if (c->strings_len + len > c->strings_size) {
+		uint32_t size = c->strings_size ? c->strings_size : 1024;
+		while (size < c->strings_len + len) size *= 2;
+		char *strings = realloc(c->strings, size);
+		if (!strings) return E_ALLOC;
+		c->strings = strings;
+		c->strings_size = size;
+	}
+
+	memcpy(c->strings + c->strings_len, str, len);
+	*offset = c->strings_len;
+	c->strings_len += len;
+
+	return E_OK;
+}
+
+// -----------------------------------------------------------------------
+static struct eml_node * _eml_node_add(struct eml_compiler *c)
+{
+	if (c->count >= c->size) {
+		uint32_t size = c->size ? c->size * 2 : 64;
+		struct eml_node *nodes = realloc(c->nodes, size * sizeof(struct eml_node));
+		if (!nodes) return NULL;
+		c->nodes = nodes;
+		c->size = size;
+	}
+
+	struct eml_node *n = c->nodes + c->count++;
+	memset(n, 0, sizeof(struct eml_node));
+
+	return n;
+}
+
+// -----------------------------------------------------------------------
+static void _eml_skip_ws(char **p)
+{
+	while ((**p == ' ') || (**p == '\t')) {
+		(*p)++;
+	}
+}
+
+// -----------------------------------------------------------------------
+static int _eml_at_end(char **p)
+{
+	_eml_skip_ws(p);
+
+	return !**p || (**p == '#') || (**p == '\n') || (**p == '\r');
+}
+
+// -----------------------------------------------------------------------
+static int _eml_ws(char c)
+{
+	return (c == ' ') || (c == '\t') || (c == '\n') || (c == '\r');
+}
+
+// -----------------------------------------------------------------------
+static char * _eml_word(char **p)
+{
+	char *word = *p;
+
+	while (**p && !_eml_ws(**p)) {
+		(*p)++;
+	}
+
+	if (*p == word) return NULL;
+
+	if (**p) {
+		**p = '\0';
+		(*p)++;
+	}
+
+	return word;
+}
+
+// -----------------------------------------------------------------------
+static char * _eml_string(char **p)
+{
+	if (**p != '"') return NULL;
+
+	// unescape in place
+	char *r = *p + 1;
+	char *w = r;
+	char *str = w;
+
+	while (*r != '"') {
+		if (!*r || (*r == '\n')) return NULL;
+		if (*r == '\\') {
+			r++;
+			switch (*r) {
+				case 'n': *w++ = '\n'; break;
+				case 't': *w++ = '\t'; break;
+				case '"':
+				case '\\': *w++ = *r; break;
+				default: return NULL;
+			}
+			r++;
+		} else {
+			*w++ = *r++;
+		}
+	}
+
+	*p = r + 1;
+	*w = '\0';
+
+	return str;
+}
+
+// -----------------------------------------------------------------------
+static int _eml_term(char *s, char *e, int *v)
+{
+	char *end;
+
+	if (s == e) return E_SYNTAX;
+
+	long l = strtol(s, &end, 0);
+	if (end == e) {
+		*v = l;
+		return E_OK;
+	}
+
+	for (const struct eml_const *k=eml_consts ; k->name ; k++) {
+		if ((strlen(k->name) == (size_t) (e - s)) && !strncmp(k->name, s, e - s)) {
+			*v = k->value;
+			return E_OK;
+		}
+	}
+
+	return E_SYNTAX;
+}
+
+// -----------------------------------------------------------------------
+static int _eml_expr(char *s, int *v)
+{
+	char op = '|';
+	int term;
+
+	*v = 0;
+
+	while (1) {
+		char *e = s;
+		while (*e && (*e != '|') && (*e != '+')) e++;
+		if (_eml_term(s, e, &term) != E_OK) return E_SYNTAX;
+		*v = (op == '|') ? (*v | term) : (*v + term);
+		if (!*e) break;
+		op = *e;
+		s = e + 1;
+	}
+
+	return E_OK;
+}
+
+// -----------------------------------------------------------------------
+static int _eml_hint(char *s, int16_t *hint)
+{
+	for (int i=0 ; i<4 ; i++) {
+		char *e = strchr(s, ',');
+		if ((i < 3) != (e != NULL)) return E_SYNTAX;
+		if (e) *e = '\0';
+		int v;
+		if ((_eml_expr(s, &v) != E_OK) || (v < INT16_MIN) || (v > INT16_MAX)) return E_SYNTAX;
+		hint[i] = v;
+		s = e + 1;
+	}
+
+	return E_OK;
+}
+
+// -----------------------------------------------------------------------
+static int _eml_attr(struct eml_compiler *c, struct eml_node *n, char **p)
+{
+	char *attr = *p;
+	char *val;
+	int v;
+
+	while (**p && (**p != '=') && !_eml_ws(**p)) {
+		(*p)++;
+	}
+	if ((**p != '=') || (*p == attr)) return E_SYNTAX;
+	**p = '\0';
+	(*p)++;
+
+	if (!strcmp(attr, "name") || !strcmp(attr, "text")) {
+		int is_name = (attr[0] == 'n');
+		if ((!is_name) && (n->type != EML_LINEEDIT)) return E_SYNTAX;
+		if (!(val = _eml_string(p))) return E_SYNTAX;
+		n->flags |= is_name ? EMLF_NAME : EMLF_TEXT;
+		return _eml_string_add(c, val, is_name ? &n->name : &n->text);
+	} else if (!strcmp(attr, "key")) {
+		val = (**p == '"') ? _eml_string(p) : _eml_word(p);
+		if (!val) return E_SYNTAX;
+		n->flags |= EMLF_KEY;
+		return _eml_string_add(c, val, &n->key);
+	} else if (!strcmp(attr, "props")) {
+		if (!(val = _eml_word(p)) || (_eml_expr(val, &v) != E_OK) || (v & ~P_APP_SETTABLE)) return E_SYNTAX;
+		n->flags |= EMLF_PROPS;
+		n->props = v;
+	} else if (!strcmp(attr, "hint")) {
+		if (!(val = _eml_word(p)) || (_eml_hint(val, n->hint) != E_OK)) return E_SYNTAX;
+		n->flags |= EMLF_HINT;
+	} else if (!strcmp(attr, "slot")) {
+		if (!(val = _eml_word(p)) || (_eml_expr(val, &v) != E_OK) || (v < 0) || (v >= EML_SLOTS_MAX)) return E_SYNTAX;
+		n->flags |= EMLF_SLOT;
+		n->slot = v;
+		if (v >= c->slots) c->slots = v + 1;
+	} else {
+		return E_SYNTAX;
+	}
+
+	return E_OK;
+}
+
+// -----------------------------------------------------------------------
+static int _eml_line(struct eml_compiler *c, char *line)
+{
+	char *p = line;
+	int indent = 0;
+	int res;
+
+	for ( ; (*p == ' ') || (*p == '\t') ; p++) {
+		indent = (*p == '\t') ? (indent / EML_TAB + 1) * EML_TAB : indent + 1;
+	}
+
+	if (_eml_at_end(&p)) return E_OK;
+
+	char *type = _eml_word(&p);
+	int t;
+	for (t=0 ; t<EML_TYPES ; t++) {
+		if (!strcmp(type, eml_types[t].name)) break;
+	}
+	if (t >= EML_TYPES) return E_SYNTAX;
+
+	// find the parent
+	while ((c->depth > 0) && (c->indent[c->depth-1] >= indent)) {
+		c->depth--;
+	}
+	int parent = c->depth ? c->stack[c->depth-1] : -1;
+
+	if (parent < 0) {
+		// only one top-level tile
+		if (c->count) return E_SYNTAX;
+	} else {
+		struct eml_node *pn = c->nodes + parent;
+		if (!eml_types[pn->type].container || (pn->children == UINT16_MAX)) return E_SYNTAX;
+		pn->children++;
+	}
+
+	if (c->depth >= EML_DEPTH_MAX) return E_SYNTAX;
+	c->stack[c->depth] = c->count;
+	c->indent[c->depth] = indent;
+	c->depth++;
+
+	struct eml_node *n = _eml_node_add(c);
+	if (!n) return E_ALLOC;
+	n->type = t;
+
+	// constructor arguments
+	int arg = 0;
+	for (char *a=eml_types[t].args ; *a ; a++) {
+		if (_eml_at_end(&p)) return E_SYNTAX;
+		if (*a == 's') {
+			char *val = _eml_string(&p);
+			if (!val) return E_SYNTAX;
+			n->flags |= EMLF_STR;
+			if ((res = _eml_string_add(c, val, &n->str)) != E_OK) return res;
+		} else {
+			char *val = _eml_word(&p);
+			int v;
+			if (_eml_expr(val, &v) != E_OK) return E_SYNTAX;
+			n->arg[arg++] = v;
+		}
+	}
+
+	// attributes
+	while (!_eml_at_end(&p)) {
+		if ((res = _eml_attr(c, n, &p)) != E_OK) return res;
+	}
+
+	// flex hints make sense only for flex children
+	if ((n->flags & EMLF_HINT) && (parent >= 0) && (c->nodes[parent].type != EML_FLEX)) {
+		return E_SYNTAX;
+	}
+
+	return E_OK;
+}
+
+// -----------------------------------------------------------------------
+static int _eml_write(struct eml_compiler *c, char *dst)
+{
+	struct eml_header h = {
+		.magic = { 'E', 'M', 'L', 'Y' },
+		.version = EML_VERSION,
+		.nodes = c->count,
+		.strings_size = c->strings_len,
+	};
+
+	FILE *f = fopen(dst, "wb");
+	if (!f) return E_IO;
+
+	int ok = (fwrite(&h, sizeof(h), 1, f) == 1)
+		&& (fwrite(c->nodes, sizeof(struct eml_node), c->count, f) == c->count)
+		&& (fwrite(c->strings, 1, c->strings_len, f) == c->strings_len);
+
+	if (fclose(f) || !ok) {
+		remove(dst);
+		return E_IO;
+	}
+
+	return E_OK;
+}
+
+// -----------------------------------------------------------------------
+int emui_layout_compile(char *src, char *dst, int *err_line)
+{
+	struct eml_compiler c;
+	char *line = NULL;
+	size_t line_size = 0;
+	int lineno = 0;
+	int res = E_OK;
+
+	FILE *f = fopen(src, "r");
+	if (!f) return E_IO;
+
+	memset(&c, 0, sizeof(c));
+
+	while (getline(&line, &line_size, f) >= 0) {
+		lineno++;
+		if ((res = _eml_line(&c, line)) != E_OK) break;
+	}
+
+	if (res == E_OK) {
+		if (ferror(f)) {
+			res = E_IO;
+		} else if (!c.count) {
+			res = E_SYNTAX;
+		}
+	}
+
+	if (res == E_OK) {
+		res = _eml_write(&c, dst);
+	} else if (err_line) {
+		*err_line = lineno;
+	}
+
+	free(line);
+	free(c.nodes);
+	free(c.strings);
+	fclose(f);
+
+	return res;
+}
+
+// -----------------------------------------------------------------------
+static int _eml_check_str(struct eml_file *f, const struct eml_node *n, int flag, uint32_t offset)
+{
+	return !(n->flags & flag) || (offset < f->strings_size);
+}
+
+// -----------------------------------------------------------------------
+static int _eml_open(struct eml_file *f, const char *map, size_t size)
+{
+	const struct eml_header *h = (const struct eml_header *) map;
+
+	if ((size < sizeof(struct eml_header)) || memcmp(h->magic, "EMLY", 4) || (h->version != EML_VERSION)) {
+		return E_SYNTAX;
+	}
+	if (!h->nodes || (h->nodes > (size - sizeof(struct eml_header)) / sizeof(struct eml_node))) {
+		return E_SYNTAX;
+	}
+	if (size - sizeof(struct eml_header) - (size_t) h->nodes * sizeof(struct eml_node) != h->strings_size) {
+		return E_SYNTAX;
+	}
+
+	f->nodes = (const struct eml_node *) (map + sizeof(struct eml_header));
+	f->count = h->nodes;
+	f->strings = (const char *) (f->nodes + f->count);
+	f->strings_size = h->strings_size;
+	f->pos = 0;
+
+	// all strings need to end within the blob
+	if (f->strings_size && f->strings[f->strings_size-1]) {
+		return E_SYNTAX;
+	}
+
+	// nodes need to form exactly one tree in pre-order,
+	// no deeper than the compiler allows (tree is built recursively)
+	uint32_t left[EML_DEPTH_MAX];
+	int depth = 0;
+	for (uint32_t i=0 ; i<f->count ; i++) {
+		const struct eml_node *n = f->nodes + i;
+		while ((depth > 0) && !left[depth-1]) {
+			depth--;
+		}
+		if (i > 0) {
+			// more than one top-level tile
+			if (!depth) return E_SYNTAX;
+			left[depth-1]--;
+		}
+		if ((depth >= EML_DEPTH_MAX) || (n->type >= EML_TYPES)) return E_SYNTAX;
+		if (n->children && !eml_types[n->type].container) return E_SYNTAX;
+		if (!_eml_check_str(f, n, EMLF_STR, n->str)
+			|| !_eml_check_str(f, n, EMLF_NAME, n->name)
+			|| !_eml_check_str(f, n, EMLF_KEY, n->key)
+			|| !_eml_check_str(f, n, EMLF_TEXT, n->text)) {
+			return E_SYNTAX;
+		}
+		left[depth++] = n->children;
+	}
+
+	// every container needs to get all its children
+	while (depth > 0) {
+		if (left[--depth]) return E_SYNTAX;
+	}
+
+	return E_OK;
+}
+
+// -----------------------------------------------------------------------
+static int _eml_setup(EMTILE *t, struct eml_file *f, const struct eml_node *n)
+{
+	char *s = (char *) f->strings;
+
+	if ((n->flags & EMLF_NAME) && (emtile_set_name(t, s + n->name) != E_OK)) {
+		return E_ALLOC;
+	}
+	if (n->flags & EMLF_KEY) {
+		int key = emui_key_code(s + n->key);
+		if (key < 0) {
+			EDBG(t, 1, "layout: unknown focus key: %s", s + n->key);
+			return E_SYNTAX;
+		}
+		if (emtile_set_focus_key(t, key) != E_OK) {
+			return E_CONFLICT;
+		}
+	}
+	if ((n->flags & EMLF_PROPS) && (emtile_set_properties(t, n->props) != E_OK)) {
+		return E_SYNTAX;
+	}
+	if ((n->flags & EMLF_HINT) && (emui_flex_hint(t, n->hint[0], n->hint[1], n->hint[2], n->hint[3]) != E_OK)) {
+		return E_CONFLICT;
+	}
+	if ((n->flags & EMLF_TEXT) && (n->type == EML_LINEEDIT)) {
+		emui_lineedit_set_text(t, s + n->text);
+	}
+
+	return E_OK;
+}
+
+// -----------------------------------------------------------------------
+static EMTILE * _eml_build(EMTILE *parent, struct eml_file *f, EMTILE **slots)
+{
+	const struct eml_node *n = f->nodes + f->pos++;
+	const int32_t *a = n->arg;
+	char *str = (n->flags & EMLF_STR) ? (char *) f->strings + n->str : NULL;
+	EMTILE *t = NULL;
+
+	switch (n->type) {
+		case EML_DUMMY:
+			t = emui_dummy_cont(parent, a[0], a[1], a[2], a[3]);
+			break;
+		case EML_FRAME:
+			t = emui_frame(parent, a[0], a[1], a[2], a[3], str, a[4]);
+			break;
+		case EML_SPLITTER:
+			t = emui_splitter(parent, a[0], a[1], a[2], a[3]);
+			break;
+		case EML_TABS:
+			t = emui_tabs(parent);
+			break;
+		case EML_JUSTIFIER:
+			t = emui_justifier(parent);
+			break;
+		case EML_FLEX:
+			t = emui_flex(parent, a[0]);
+			break;
+		case EML_GRID:
+			t = emui_grid(parent, a[0], a[1], a[2], a[3], a[4]);
+			break;
+		case EML_LIST:
+			t = emui_list(parent);
+			break;
+		case EML_LABEL:
+			t = emui_label(parent, a[0], a[1], a[2], a[3], str);
+			break;
+		case EML_LINEEDIT:
+			t = emui_lineedit(parent, a[0], a[1], a[2], a[3], a[4], a[5]);
+			break;
+		case EML_LINE:
+			t = emui_line(parent, a[0], a[1], a[2], a[3]);
+			break;
+	}
+
+	if (!t) return NULL;
+
+	if (_eml_setup(t, f, n) != E_OK) {
+		emtile_delete(t);
+		return NULL;
+	}
+
+	if (slots && (n->flags & EMLF_SLOT)) {
+		slots[n->slot] = t;
+	}
+
+	for (int i=0 ; i<n->children ; i++) {
+		if (!_eml_build(t, f, slots)) {
+			emtile_delete(t);
+			return NULL;
+		}
+	}
+
+	return t;
+}
+
+// -----------------------------------------------------------------------
+EMTILE * emui_layout_load(EMTILE *parent, char *path)
+{
+	struct eml_file f;
+	struct stat st;
+	EMTILE *t = NULL;
+
+	int fd = open(path, O_RDONLY);
+	if (fd < 0) return NULL;
+
+	if (fstat(fd, &st) || (st.st_size < (off_t) sizeof(struct eml_header))) {
+		close(fd);
+		return NULL;
+	}
+
+	char *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED) return NULL;
+
+	if (_eml_open(&f, map, st.st_size) == E_OK) {
+		// build the whole tree first, lay it out once
+		emui_batch_begin();
+		t = _eml_build(parent, &f, NULL);
+		emui_batch_commit();
+		if (t) {
+			EDBG(t, 1, "layout loaded from %s: %i tiles", path, f.count);
+		}
+	}
+
+	munmap(map, st.st_size);
+
+	return t;
+}
+
+// -----------------------------------------------------------------------
+EMTPL * emui_template(char *text, int *err_line)
+{
+	struct eml_compiler c;
+	EMTPL *tpl = NULL;
+	int lineno = 0;
+	int res = E_OK;
+
+	char *buf = strdup(text);
+	if (!buf) return NULL;
+
+	memset(&c, 0, sizeof(c));
+
+	char *next;
+	for (char *line=buf ; line ; line=next) {
+		next = strchr(line, '\n');
+		if (next) *next++ = '\0';
+		lineno++;
+		if ((res = _eml_line(&c, line)) != E_OK) break;
+	}
+
+	if ((res == E_OK) && !c.count) {
+		res = E_SYNTAX;
+	}
+
+	if (res == E_OK) {
+		tpl = malloc(sizeof(EMTPL));
+	} else if (err_line) {
+		*err_line = lineno;
+	}
+
+	if (tpl) {
+		tpl->nodes = c.nodes;
+		tpl->count = c.count;
+		tpl->strings = c.strings;
+		tpl->strings_size = c.strings_len;
+		tpl->slots = c.slots;
+	} else {
+		free(c.nodes);
+		free(c.strings);
+	}
+
+	free(buf);
+
+	return tpl;
+}
+
+// -----------------------------------------------------------------------
+void emui_template_delete(EMTPL *tpl)
+{
+	if (!tpl) return;
+
+	free(tpl->nodes);
+	free(tpl->strings);
+	free(tpl);
+}
+
+// -----------------------------------------------------------------------
+int emui_template_instantiate(EMTPL *tpl, EMTILE *parent, int count, emui_template_bind_f bind, void *ptr)
+{
+	struct eml_file f = {
+		.nodes = tpl->nodes,
+		.count = tpl->count,
+		.strings = tpl->strings,
+		.strings_size = tpl->strings_size,
+	};
+	EMTILE *slots[EML_SLOTS_MAX];
+	int res = E_OK;
+
+	emui_batch_begin();
+
+	for (int i=0 ; i<count ; i++) {
+		memset(slots, 0, tpl->slots * sizeof(EMTILE *));
+		f.pos = 0;
+		EMTILE *t = _eml_build(parent, &f, slots);
+		if (!t) {
+			res = E_ALLOC;
+			break;
+		}
+		if (bind) {
+			bind(t, slots, i, ptr);
+		}
+	}
+
+	emui_batch_commit();
+
+	return res;
+}
+
+// vim: tabstop=4 shiftwidth=4 autoindent
@@ -0,0 +1,199 @@
+//  Copyright (c) 2015 Jakub Filipowicz <jakubf@gmail.com>
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc.,
+//  51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+
+#include <stdlib.h>
+#include <string.h>
+#include <ncurses.h>
+
+#include "dbg.h"
+#include "tile.h"
+#include "tiletab.h"
+#include "lcache.h"
+
+// Layout cache remembers complete layouts (geometry of every tile,
+// in tile table order) for a few most recently used terminal sizes.
+//
+// Cached layout is valid as long as nothing else it depends on has changed:
+// any change to the tree structure or any geometry change request
+// starts a new layout version, and layouts are looked up by terminal
+// size and the current version.
+//
+// Containers with P_LAYOUT_STATE keep state that depends on more than
+// geometry (focus, scroll position, ...). These get to lay out their
+// children again after the layout is restored, and are refitted
+// as usual if the result is different.
+
+#define LC_ENTRIES 4
+
+struct lc_row {
+	struct emui_geom e;
+	struct emui_geom i;
+	struct emui_fit_inputs fi;
+};
+
+struct lc_entry {
+	int w, h;
+	unsigned long version;
+	unsigned long used;
+	struct lc_row *rows;
+	int count;
+	int size;
+};
+
+static struct lc_entry lc[LC_ENTRIES];
+static unsigned long lc_version = 1;
+static unsigned long lc_clock;
+
+// -----------------------------------------------------------------------
+void emui_lcache_invalidate()
+{
+	lc_version++;
+}
+
+// -----------------------------------------------------------------------
+static struct lc_entry * _lc_find(int w, int h)
+{
+	for (int i=0 ; i<LC_ENTRIES ; i++) {
+		struct lc_entry *le = lc + i;
+		if (le->rows && (le->w == w) && (le->h == h) && (le->version == lc_version)) {
+			return le;
+		}
+	}
+
+	return NULL;
+}
+
+// -----------------------------------------------------------------------
+int emui_lcache_store(EMTILE *root)
+{
+	int count = emui_tiletab_count();
+
+	if (!count || (emui_tiletab_tile(0) != root)) {
+		return E_CONFLICT;
+	}
+
+	// only a complete layout is worth remembering
+	for (int k=0 ; k<count ; k++) {
+		if (emui_tiletab_tile(k)->geometry_changed) {
+			return E_CONFLICT;
+		}
+	}
+
+	// reuse entry for the same size, or the least recently used one
+	struct lc_entry *le = lc;
+	for (int i=0 ; i<LC_ENTRIES ; i++) {
+		if ((lc[i].w == COLS) && (lc[i].h == LINES)) {
+			le = lc + i;
+			break;
+		}
+		if (lc[i].used < le->used) {
+			le = lc + i;
+		}
+	}
+
+	if (count > le->size) {
+		struct lc_row *rows = realloc(le->rows, count * sizeof(struct lc_row));
+		if (!rows) return E_ALLOC;
+		le->rows = rows;
+		le->size = count;
+	}
+
+	for (int k=0 ; k<count ; k++) {
+		EMTILE *t = emui_tiletab_tile(k);
+		le->rows[k].e = t->e;
+		le->rows[k].i = t->i;
+		le->rows[k].fi = t->fi;
+	}
+
+	le->w = COLS;
+	le->h = LINES;
+	le->version = lc_version;
+	le->count = count;
+	le->used = ++lc_clock;
+
+	EDBG(root, 1, "layout cached for %ix%i: %i tiles", COLS, LINES, count);
+
+	return E_OK;
+}
+
+// -----------------------------------------------------------------------
+static int _lc_children_match(EMTILE *t, struct lc_entry *le)
+{
+	for (EMTILE *ch=t->ch_first ; ch ; ch=ch->ch_next) {
+		struct lc_row *row = le->rows + ch->tt_idx;
+		if (memcmp(&ch->e, &row->e, sizeof(struct emui_geom))) {
+			return 0;
+		}
+		if ((ch->properties ^ row->fi.properties) & P_HIDDEN) {
+			return 0;
+		}
+	}
+
+	return 1;
+}
+
+// -----------------------------------------------------------------------
+int emui_lcache_apply(EMTILE *root)
+{
+	// root picks up the new terminal size
+	if (root->drv->update_children_geometry) {
+		root->drv->update_children_geometry(root);
+	}
+
+	struct lc_entry *le = _lc_find(COLS, LINES);
+	int count = emui_tiletab_count();
+
+	if (!le || (le->count != count) || (emui_tiletab_tile(0) != root)) {
+		return 0;
+	}
+
+	for (int k=0 ; k<count ; k++) {
+		struct lc_row *row = le->rows + k;
+		_emtile_restore_geometry(emui_tiletab_tile(k), &row->e, &row->i, &row->fi);
+	}
+
+	// let stateful containers check if their layout still holds
+	for (int k=0 ; k<count ; k++) {
+		EMTILE *t = emui_tiletab_tile(k);
+		if ((t->properties & P_LAYOUT_STATE) && t->drv->update_children_geometry) {
+			t->drv->update_children_geometry(t);
+			if (!_lc_children_match(t, le)) {
+				EDBG(t, 1, "cached layout doesn't hold for container");
+				t->geometry_changed = 1;
+				emui_tiletab_update(t);
+			}
+		}
+	}
+
+	le->used = ++lc_clock;
+
+	EDBG(root, 1, "layout restored for %ix%i: %i tiles", COLS, LINES, count);
+
+	return count;
+}
+
+// -----------------------------------------------------------------------
+void emui_lcache_destroy()
+{
+	for (int i=0 ; i<LC_ENTRIES ; i++) {
+		free(lc[i].rows);
+		lc[i].rows = NULL;
+		lc[i].count = lc[i].size = 0;
+	}
+}
+
+// vim: tabstop=4 shiftwidth=4 autoindent
@@ -0,0 +1,458 @@
+//  Copyright (c) 2015 Jakub Filipowicz <jakubf@gmail.com>
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc.,
+//  51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <signal.h>
+#include <sched.h>
+#include <pthread.h>
+
+#include "dbg.h"
+#include "tile.h"
+#include "tiletab.h"
+#include "lpool.h"
+
+// Layout pool lays out independent subtrees of a large tree in parallel.
+//
+// Every subtree of a container is a task. Each worker (main thread
+// being one of them) keeps its own deque of tasks: it takes the newest
+// task itself (depth-first), and idle workers steal the oldest (biggest)
+// ones. Leaves are laid out right away, they're not worth a task.
+//
+// Workers only do the geometry part of the fit, which touches nothing
+// but the subtree. Window operations, hit map, focus group index
+// and tile table updates are recorded and done on the main thread
+// afterwards. So are subtrees that can't be laid out in parallel:
+// containers with P_LAYOUT_SERIAL (their layout has side effects,
+// eg. creates tiles), containers whose driver isn't marked with
+// pure_geometry (their layout may read or write global state, eg. focus
+// or tile properties), floating tiles and tiles laid out relative
+// to a tile other than their parent.
+//
+// Debug builds log from within the fit, so they always lay out serially.
+
+#define LP_THREADS_MAX 16
+#define LP_MIN_TILES 2048
+
+struct lp_done {
+	EMTILE *t;
+	struct emui_geom i;		// interior geometry before the fit
+};
+
+struct lp_serial {
+	EMTILE *t;
+	int parent_changed;		// parent has been laid out again
+};
+
+struct lp_worker {
+	pthread_t thread;
+	unsigned long generation;
+	pthread_mutex_t lock;	// guards the task deque
+	EMTILE **tasks;
+	int head, tail;
+	int tasks_size;
+	struct lp_done *done;
+	int done_count, done_size;
+	struct lp_serial *serial;
+	int serial_count, serial_size;
+	int failed;
+};
+
+static struct lp_worker *workers;
+static int worker_count;
+static int threads_wanted;
+
+static pthread_mutex_t pool_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t pool_wake = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t pool_idle = PTHREAD_COND_INITIALIZER;
+static unsigned long pool_generation;
+static int pool_running;
+static int pool_quit;
+
+static int tasks_pending;
+
+// -----------------------------------------------------------------------
+static int _lp_push(struct lp_worker *w, EMTILE *t)
+{
+	int ret = E_OK;
+
+	pthread_mutex_lock(&w->lock);
+
+	if (w->tail >= w->tasks_size) {
+		// reclaim space left by stolen tasks first
+		if (w->head > 0) {
+			memmove(w->tasks, w->tasks + w->head, (w->tail - w->head) * sizeof(EMTILE *));
+			w->tail -= w->head;
+			w->head = 0;
+		}
+		if (w->tail >= w->tasks_size) {
+			int size = w->tasks_size ? w->tasks_size * 2 : 64;
+			EMTILE **tasks = realloc(w->tasks, size * sizeof(EMTILE *));
+			if (tasks) {
+				w->tasks = tasks;
+				w->tasks_size = size;
+			} else {
+				ret = E_ALLOC;
+			}
+		}
+	}
+
+	if (ret == E_OK) {
+		__atomic_add_fetch(&tasks_pending, 1, __ATOMIC_SEQ_CST);
+		w->tasks[w->tail++] = t;
+	}
+
+	pthread_mutex_unlock(&w->lock);
+
+	return ret;
+}
+
+// -----------------------------------------------------------------------
+static EMTILE * _lp_take(struct lp_worker *w, int steal)
+{
+	EMTILE *t = NULL;
+
+	pthread_mutex_lock(&w->lock);
+
+	if (w->tail > w->head) {
+		t = steal ? w->tasks[w->head++] : w->tasks[--w->tail];
+	}
+	if (w->head == w->tail) {
+		w->head = w->tail = 0;
+	}
+
+	pthread_mutex_unlock(&w->lock);
+
+	return t;
+}
+
+// -----------------------------------------------------------------------
+static int _lp_done_add(struct lp_worker *w, EMTILE *t)
+{
+	if (w->done_count >= w->done_size) {
+		int size = w->done_size ? w->done_size * 2 : 256;
+		struct lp_done *done = realloc(w->done, size * sizeof(struct lp_done));
+		if (!done) return E_ALLOC;
+		w->done = done;
+		w->done_size = size;
+	}
+
+	w->done[w->done_count].t = t;
+	w->done[w->done_count].i = t->i;
+	w->done_count++;
+
+	return E_OK;
+}
+
+// -----------------------------------------------------------------------
+static int _lp_serial_add(struct lp_worker *w, EMTILE *t, int parent_changed)
+{
+	if (w->serial_count >= w->serial_size) {
+		int size = w->serial_size ? w->serial_size * 2 : 16;
+		struct lp_serial *serial = realloc(w->serial, size * sizeof(struct lp_serial));
+		if (!serial) return E_ALLOC;
+		w->serial = serial;
+		w->serial_size = size;
+	}
+
+	w->serial[w->serial_count].t = t;
+	w->serial[w->serial_count].parent_changed = parent_changed;
+	w->serial_count++;
+
+	return E_OK;
+}
+
+// -----------------------------------------------------------------------
+static int _lp_serial_needed(EMTILE *t)
+{
+	if (t->properties & (P_LAYOUT_SERIAL | P_FLOAT)) {
+		return 1;
+	}
+
+	// driver's layout may have side effects outside the subtree
+	if (t->drv->update_children_geometry && !t->drv->pure_geometry) {
+		return 1;
+	}
+
+	// geometry depends on a tile from another subtree
+	return (t->pg != &t->parent->i) && (t->pg != &t->parent->e);
+}
+
+// -----------------------------------------------------------------------
+static void _lp_subtree(struct lp_worker *w, EMTILE *t);
+
+// -----------------------------------------------------------------------
+static void _lp_children(struct lp_worker *w, EMTILE *t, int geometry_changed)
+{
+	struct emtile_visit v;
+	for (EMTILE *ch=_emtile_visit_first(t, &v) ; ch ; ch=_emtile_visit_next(&v)) {
+		if (_lp_serial_needed(ch)) {
+			// can't check if refit is needed here, that reads other subtrees
+			if (_lp_serial_add(w, ch, geometry_changed) != E_OK) {
+				ch->geometry_changed = 1;
+				w->failed = 1;
+			}
+			continue;
+		}
+
+		// refit only children whose layout inputs have changed
+		if (geometry_changed && emtile_fit_needed(ch)) {
+			ch->geometry_changed = 1;
+		}
+
+		if (!ch->ch_first || (_lp_push(w, ch) != E_OK)) {
+			_lp_subtree(w, ch);
+		}
+	}
+}
+
+// -----------------------------------------------------------------------
+static void _lp_subtree(struct lp_worker *w, EMTILE *t)
+{
+	int geometry_changed = t->geometry_changed;
+
+	if (geometry_changed) {
+		// tile stays marked, and is laid out serially later
+		if (_lp_done_add(w, t) != E_OK) {
+			w->failed = 1;
+			return;
+		}
+		_emtile_fit_geometry(t);
+	}
+
+	_lp_children(w, t, geometry_changed);
+}
+
+// -----------------------------------------------------------------------
+static void _lp_work(struct lp_worker *w)
+{
+	int idx = w - workers;
+
+	while (1) {
+		EMTILE *t = _lp_take(w, 0);
+
+		// nothing left locally, try stealing from others
+		for (int i=1 ; !t && (i<worker_count) ; i++) {
+			t = _lp_take(workers + (idx + i) % worker_count, 1);
+		}
+
+		if (t) {
+			_lp_subtree(w, t);
+			__atomic_sub_fetch(&tasks_pending, 1, __ATOMIC_SEQ_CST);
+		// all tasks (including ones being worked on) are done
+		} else if (!__atomic_load_n(&tasks_pending, __ATOMIC_SEQ_CST)) {
+			break;
+		} else {
+			sched_yield();
+		}
+	}
+}
+
+// -----------------------------------------------------------------------
+static void * _lp_thread(void *ptr)
+{
+	struct lp_worker *w = ptr;
+	unsigned long seen = w->generation;
+
+	pthread_mutex_lock(&pool_lock);
+	while (1) {
+		while (!pool_quit && (pool_generation == seen)) {
+			pthread_cond_wait(&pool_wake, &pool_lock);
+		}
+		if (pool_quit) break;
+		seen = pool_generation;
+		pthread_mutex_unlock(&pool_lock);
+
+		_lp_work(w);
+
+		pthread_mutex_lock(&pool_lock);
+		if (--pool_running == 0) {
+			pthread_cond_signal(&pool_idle);
+		}
+	}
+	pthread_mutex_unlock(&pool_lock);
+
+	return NULL;
+}
+
+// -----------------------------------------------------------------------
+static void _lp_stop()
+{
+	if (!workers) return;
+
+	pthread_mutex_lock(&pool_lock);
+	pool_quit = 1;
+	pthread_cond_broadcast(&pool_wake);
+	pthread_mutex_unlock(&pool_lock);
+
+	for (int i=0 ; i<worker_count ; i++) {
+		struct lp_worker *w = workers + i;
+		// worker 0 is the main thread
+		if (i > 0) {
+			pthread_join(w->thread, NULL);
+		}
+		pthread_mutex_destroy(&w->lock);
+		free(w->tasks);
+		free(w->done);
+		free(w->serial);
+	}
+
+	free(workers);
+	workers = NULL;
+	worker_count = 0;
+	pool_quit = 0;
+}
+
+// -----------------------------------------------------------------------
+static int _lp_start()
+{
+	int count = threads_wanted;
+	sigset_t all, old;
+
+	// one thread per CPU by default
+	if (count <= 0) {
+		long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+		count = cpus > 0 ? cpus : 1;
+	}
+	if (count > LP_THREADS_MAX) {
+		count = LP_THREADS_MAX;
+	}
+	if (count < 2) {
+		return E_CONFLICT;
+	}
+
+	workers = calloc(count, sizeof(struct lp_worker));
+	if (!workers) return E_ALLOC;
+
+	pthread_mutex_init(&workers[0].lock, NULL);
+	worker_count = 1;
+
+	// signals (SIGWINCH) are for the main thread to handle
+	sigfillset(&all);
+	pthread_sigmask(SIG_SETMASK, &all, &old);
+
+	for (int i=1 ; i<count ; i++) {
+		struct lp_worker *w = workers + i;
+		w->generation = pool_generation;
+		pthread_mutex_init(&w->lock, NULL);
+		if (pthread_create(&w->thread, NULL, _lp_thread, w)) {
+			pthread_mutex_destroy(&w->lock);
+			break;
+		}
+		worker_count++;
+	}
+
+	pthread_sigmask(SIG_SETMASK, &old, NULL);
+
+	if (worker_count < 2) {
+		_lp_stop();
+		return E_CONFLICT;
+	}
+
+	EDBG(NULL, 1, "layout pool started: %i threads", worker_count);
+
+	return E_OK;
+}
+
+// -----------------------------------------------------------------------
+void emui_lpool_threads(int threads)
+{
+	// pool is started again with the new size when needed
+	_lp_stop();
+	threads_wanted = threads;
+}
+
+// -----------------------------------------------------------------------
+int emui_lpool_layout(EMTILE *root, emui_void_f fit_tree)
+{
+#ifdef DEBUG
+	return E_CONFLICT;
+#endif
+
+	// small trees are laid out faster by a single thread
+	if (emui_tiletab_count() < LP_MIN_TILES) {
+		return E_CONFLICT;
+	}
+	if (!workers && (_lp_start() != E_OK)) {
+		return E_CONFLICT;
+	}
+
+	int geometry_changed = root->geometry_changed;
+	if (geometry_changed) {
+		emtile_fit(root);
+	}
+
+	// queue root's subtrees, then let everyone in
+	_lp_children(workers, root, geometry_changed);
+
+	pthread_mutex_lock(&pool_lock);
+	pool_generation++;
+	pool_running = worker_count - 1;
+	pthread_cond_broadcast(&pool_wake);
+	pthread_mutex_unlock(&pool_lock);
+
+	_lp_work(workers);
+
+	pthread_mutex_lock(&pool_lock);
+	while (pool_running > 0) {
+		pthread_cond_wait(&pool_idle, &pool_lock);
+	}
+	pthread_mutex_unlock(&pool_lock);
+
+	// finish what the workers have laid out
+	int failed = 0;
+	for (int i=0 ; i<worker_count ; i++) {
+		struct lp_worker *w = workers + i;
+		EDBG(root, 1, "layout worker %i: %i tiles, %i serial subtrees", i, w->done_count, w->serial_count);
+		for (int k=0 ; k<w->done_count ; k++) {
+			_emtile_fit_finish(w->done[k].t, &w->done[k].i);
+		}
+		w->done_count = 0;
+		failed |= w->failed;
+		w->failed = 0;
+	}
+
+	// subtrees that need to be laid out serially go last
+	for (int i=0 ; i<worker_count ; i++) {
+		struct lp_worker *w = workers + i;
+		for (int k=0 ; k<w->serial_count ; k++) {
+			EMTILE *t = w->serial[k].t;
+			if (w->serial[k].parent_changed && emtile_fit_needed(t)) {
+				t->geometry_changed = 1;
+			}
+			fit_tree(t);
+		}
+		w->serial_count = 0;
+	}
+
+	// lay out anything that has been skipped due to lack of memory
+	if (failed) {
+		fit_tree(root);
+	}
+
+	return E_OK;
+}
+
+// -----------------------------------------------------------------------
+void emui_lpool_destroy()
+{
+	_lp_stop();
+}
+
+// vim: tabstop=4 shiftwidth=4 autoindent
@@ -0,0 +1,217 @@
+//  Copyright (c) 2015 Jakub Filipowicz <jakubf@gmail.com>
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc.,
+//  51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <ctype.h>
+#include <ncurses.h>
+
+#include "dbg.h"
+#include "tile.h"
+#include "event.h"
+#include "focus.h"
+#include "hitmap.h"
+#include "mouse.h"
+
+// button-event tracking (clicks, wheel, drag) reported in SGR format
+#define MOUSE_ON "\033[?1002h\033[?1006h"
+#define MOUSE_OFF "\033[?1006l\033[?1002l"
+
+#define SGR_MAX_LEN 32
+
+#define SGR_BUTTON_MASK 3
+#define SGR_MOTION 32
+#define SGR_WHEEL 64
+
+// -----------------------------------------------------------------------
+void emui_mouse_enable()
+{
+	// don't let ncurses swallow mouse sequences, we decode them ourselves
+	keyok(KEY_MOUSE, FALSE);
+	fputs(MOUSE_ON, stdout);
+	fflush(stdout);
+}
+
+// -----------------------------------------------------------------------
+void emui_mouse_disable()
+{
+	fputs(MOUSE_OFF, stdout);
+	fflush(stdout);
+}
+
+// -----------------------------------------------------------------------
+static void _sgr_to_event(struct emui_event *ev, int cb, int x, int y, int release)
+{
+	ev->type = EV_MOUSE;
+	ev->x = x - 1;
+	ev->y = y - 1;
+
+	if (cb & SGR_WHEEL) {
+		ev->sender = (cb & SGR_BUTTON_MASK) ? MB_WHEEL_DOWN : MB_WHEEL_UP;
+	} else if (cb & SGR_MOTION) {
+		ev->sender = MB_MOTION;
+	} else if (release) {
+		ev->sender = MB_RELEASE;
+	} else {
+		switch (cb & SGR_BUTTON_MASK) {
+			case 0:
+				ev->sender = MB_LEFT;
+				break;
+			case 1:
+				ev->sender = MB_MIDDLE;
+				break;
+			case 2:
+				ev->sender = MB_RIGHT;
+				break;
+			default:
+				ev->sender = MB_RELEASE;
+				break;
+		}
+	}
+}
+
+// -----------------------------------------------------------------------
+// Read the rest of "ESC [ < b ; x ; y M" (or "m" for button release)
+// after ESC has been read. If input is not a mouse sequence,
+// all characters read are returned back to the input queue.
+int emui_mouse_sgr_read(struct emui_event *ev)
+{
+	int buf[SGR_MAX_LEN];
+	int len = 0;
+	int val[3] = { 0, 0, 0 };
+	int field = 0;
+	int ch;
+
+	while (len < SGR_MAX_LEN) {
+		ch = getch();
+		if (ch == ERR) break;
+		buf[len++] = ch;
+
+		if (len == 1) {
+			if (ch != '[') break;
+		} else if (len == 2) {
+			if (ch != '<') break;
+		} else if (isdigit(ch)) {
+			val[field] = val[field] * 10 + ch - '0';
+		} else if ((ch == ';') && (field < 2)) {
+			field++;
+		} else if (((ch == 'M') || (ch == 'm')) && (field == 2)) {
+			_sgr_to_event(ev, val[0], val[1], val[2], ch == 'm');
+			return 1;
+		} else {
+			break;
+		}
+	}
+
+	while (len > 0) {
+		ungetch(buf[--len]);
+	}
+
+	return 0;
+}
+
+// -----------------------------------------------------------------------
+static EMTILE * _scroll_group(EMTILE *t)
+{
+	while (t) {
+		if ((t->properties & P_FOCUS_GROUP) && t->drv->scroll_handler) {
+			return t;
+		}
+		t = t->parent;
+	}
+
+	return NULL;
+}
+
+// -----------------------------------------------------------------------
+static int _mouse_scroll(EMTILE *t, int dir)
+{
+	EMTILE *fg = _scroll_group(t);
+
+	if (!fg) return E_UNHANDLED;
+
+	// start at the focus group member under the pointer
+	while ((t != fg) && (t->parent != fg) && (t->fg != fg)) {
+		t = t->parent;
+	}
+	if (t == fg) {
+		t = emui_subfocus_get(fg);
+	}
+
+	// follow members in the wheel direction up to the first one
+	// outside of the view, then scroll to show it. Focus stays where it is.
+	while (!(t->properties & P_HIDDEN)) {
+		EMTILE *f = emtile_get_physical_neighbour_from(fg, t, dir, P_INTERACTIVE, P_NONE);
+		// nothing more to show
+		if (f == t) return E_HANDLED;
+		t = f;
+	}
+
+	EDBG(t, 2, "mouse wheel scrolls to show");
+	fg->drv->scroll_handler(fg, t);
+
+	return E_HANDLED;
+}
+
+// -----------------------------------------------------------------------
+static EMTILE * _focus_target(EMTILE *t)
+{
+	while (t && !(t->properties & (P_INTERACTIVE | P_FOCUS_GROUP))) {
+		t = t->parent;
+	}
+
+	return t;
+}
+
+// -----------------------------------------------------------------------
+int emui_mouse_event(struct emui_event *ev)
+{
+	EMTILE *target = emui_hitmap_get(ev->x, ev->y);
+	EMTILE *t = target;
+
+	if (!target) return E_UNHANDLED;
+
+	EDBG(target, 1, "mouse event %i at %i,%i", ev->sender, ev->x, ev->y);
+
+	// clicking focuses the tile (or its closest focusable parent)
+	if (ev->sender == MB_LEFT) {
+		emui_focus(_focus_target(target));
+	}
+
+	// tile under the pointer and its parents get the event first...
+	while (t) {
+		if (emtile_event(t, ev) == E_HANDLED) {
+			return E_HANDLED;
+		}
+		t = t->parent;
+	}
+
+	// ...then the default action is taken
+	switch (ev->sender) {
+		case MB_WHEEL_UP:
+			return _mouse_scroll(target, FC_ABOVE);
+		case MB_WHEEL_DOWN:
+			return _mouse_scroll(target, FC_BELOW);
+		default:
+			break;
+	}
+
+	return E_UNHANDLED;
+}
+
+// vim: tabstop=4 shiftwidth=4 autoindent
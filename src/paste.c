@@ -0,0 +1,143 @@
+//  Copyright (c) 2015 Jakub Filipowicz <jakubf@gmail.com>
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc.,
+//  51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <ncurses.h>
+
+#include "dbg.h"
+#include "tile.h"
+#include "event.h"
+#include "paste.h"
+
+// With bracketed paste mode enabled, terminal wraps pasted text
+// in "ESC [ 200 ~" ... "ESC [ 201 ~", which lets us deliver
+// the whole paste as a single EV_PASTE event.
+
+#define PASTE_ON "\033[?2004h"
+#define PASTE_OFF "\033[?2004l"
+
+#define PASTE_START "[200~"
+#define PASTE_END "[201~"
+
+// how long to wait for the rest of the paste (ms)
+#define PASTE_TIMEOUT 100
+
+#define PASTE_MIN_BUF 256
+
+// -----------------------------------------------------------------------
+void emui_paste_enable()
+{
+	fputs(PASTE_ON, stdout);
+	fflush(stdout);
+}
+
+// -----------------------------------------------------------------------
+void emui_paste_disable()
+{
+	fputs(PASTE_OFF, stdout);
+	fflush(stdout);
+}
+
+// -----------------------------------------------------------------------
+// Match the input against the sequence (ESC already read).
+// If input doesn't match, all characters read are returned back.
+static int _match(char *seq)
+{
+	int buf[8];
+	int len = 0;
+	int ch;
+
+	while (seq[len]) {
+		ch = getch();
+		if (ch == ERR) break;
+		buf[len] = ch;
+		if (ch != seq[len++]) break;
+		if (!seq[len]) return 1;
+	}
+
+	while (len > 0) {
+		ungetch(buf[--len]);
+	}
+
+	return 0;
+}
+
+// -----------------------------------------------------------------------
+static int _buf_put(char **buf, int *size, int len, char c)
+{
+	if (len + 1 >= *size) {
+		int nsize = *size ? *size * 2 : PASTE_MIN_BUF;
+		char *nbuf = realloc(*buf, nsize);
+		if (!nbuf) return E_ALLOC;
+		*buf = nbuf;
+		*size = nsize;
+	}
+
+	(*buf)[len] = c;
+
+	return E_OK;
+}
+
+// -----------------------------------------------------------------------
+int emui_paste_read(struct emui_event *ev)
+{
+	char *buf = NULL;
+	int size = 0;
+	int len = 0;
+	int ch;
+
+	if (!_match(PASTE_START)) {
+		return 0;
+	}
+
+	// wait for the rest of the paste, it may come in chunks
+	timeout(PASTE_TIMEOUT);
+
+	while (1) {
+		ch = getch();
+		// terminal didn't finish the paste, take what we've got
+		if (ch == ERR) {
+			EDBG(NULL, 1, "paste not terminated, got %i characters", len);
+			break;
+		}
+		if ((ch == 27) && _match(PASTE_END)) {
+			break;
+		}
+		// drop non-characters (keys decoded by ncurses)
+		if ((ch > 0xff) || (_buf_put(&buf, &size, len, ch) != E_OK)) {
+			continue;
+		}
+		len++;
+	}
+
+	timeout(0);
+
+	if (buf) {
+		buf[len] = '\0';
+	}
+
+	ev->type = EV_PASTE;
+	ev->sender = len;
+	ev->data = buf;
+
+	return 1;
+}
+
+// vim: tabstop=4 shiftwidth=4 autoindent
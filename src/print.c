@@ -1,8 +1,17 @@
+#include <stdio.h>
+#include <stdlib.h>
 #include <ncurses.h>
 #include <stdarg.h>
 
 #include "tile.h"
 #include "style.h"
+#include "print.h"
+
+// Tiles with P_SHARED_CANVAS set don't have windows of their own.
+// While such tile is drawn, t->canvas points to a window of one of its
+// parents and all printing is translated to tile's area within that window
+// and clipped to it. Output is meant to look exactly as if the tile
+// was drawn in its own window.
 
 // -----------------------------------------------------------------------
 static int _tilestyle(EMTILE *t, int style)
@@ -11,9 +20,81 @@ static int _tilestyle(EMTILE *t, int style)
 	return emui_style_get(style) ^ w_inv;
 }
 
+// -----------------------------------------------------------------------
+static void _cv_putch(EMTILE *t, chtype ch)
+{
+	if ((t->cur_y >= t->e.h) || (t->cur_x >= t->e.w)) return;
+
+	mvwaddch(t->canvas, t->cv_y + t->cur_y, t->cv_x + t->cur_x, ch);
+
+	if (++t->cur_x >= t->e.w) {
+		t->cur_x = 0;
+		t->cur_y++;
+	}
+}
+
+// -----------------------------------------------------------------------
+static int _cv_puts(EMTILE *t, char *s)
+{
+	for ( ; *s ; s++) {
+		if (t->cur_y >= t->e.h) {
+			return ERR;
+		}
+		switch (*s) {
+			case '\n':
+				// clear to the end of line, as waddch() does
+				mvwhline(t->canvas, t->cv_y + t->cur_y, t->cv_x + t->cur_x, ' ', t->e.w - t->cur_x);
+				t->cur_x = 0;
+				t->cur_y++;
+				break;
+			case '\t':
+				do {
+					_cv_putch(t, ' ');
+				} while (t->cur_x % TABSIZE);
+				break;
+			default:
+				_cv_putch(t, (unsigned char) *s);
+				break;
+		}
+	}
+
+	return OK;
+}
+
+// -----------------------------------------------------------------------
+static int _cv_vprint(EMTILE *t, char *format, va_list vl)
+{
+	char sbuf[256];
+	char *buf = sbuf;
+	va_list vl2;
+
+	va_copy(vl2, vl);
+	int len = vsnprintf(sbuf, sizeof(sbuf), format, vl2);
+	va_end(vl2);
+
+	if (len < 0) return ERR;
+
+	if (len >= sizeof(sbuf)) {
+		buf = malloc(len + 1);
+		if (!buf) return ERR;
+		vsnprintf(buf, len + 1, format, vl);
+	}
+
+	int ret = _cv_puts(t, buf);
+
+	if (buf != sbuf) free(buf);
+
+	return ret;
+}
+
 // -----------------------------------------------------------------------
 static inline int __nc_vprint(EMTILE *t, int style, char *format, va_list vl)
 {
+	if (t->canvas) {
+		wattrset(t->canvas, _tilestyle(t, style));
+		return _cv_vprint(t, format, vl);
+	}
+
 	wattrset(t->ncwin, _tilestyle(t, style));
 	return vwprintw(t->ncwin, format, vl);
 }
@@ -27,7 +108,7 @@ int vemuiprt(EMTILE *t, int style, char *format, va_list vl)
 // -----------------------------------------------------------------------
 int vemuixyprt(EMTILE *t, unsigned x, unsigned y, int style, char *format, va_list vl)
 {
-	wmove(t->ncwin, y, x);
+	emuixy(t, x, y);
 	return __nc_vprint(t, style, format, vl);
 }
 
@@ -51,7 +132,7 @@ int emuixyprt(EMTILE *t, unsigned x, unsigned y, int style, char *format, ...)
 	va_list vl;
 
 	va_start(vl, format);
-	wmove(t->ncwin, y, x);
+	emuixy(t, x, y);
 	ret = __nc_vprint(t, style, format, vl);
 	va_end(vl);
 
@@ -61,19 +142,65 @@ int emuixyprt(EMTILE *t, unsigned x, unsigned y, int style, char *format, ...)
 // -----------------------------------------------------------------------
 int emuixy(EMTILE *t, int x, int y)
 {
+	if (t->canvas) {
+		if ((x < 0) || (y < 0) || (x >= t->e.w) || (y >= t->e.h)) {
+			return ERR;
+		}
+		t->cur_x = x;
+		t->cur_y = y;
+		return wmove(t->canvas, t->cv_y + y, t->cv_x + x);
+	}
+
 	return wmove(t->ncwin, y, x);
 }
 
 // -----------------------------------------------------------------------
 int emuibox(EMTILE *t, int style)
 {
+	if (t->canvas) {
+		WINDOW *c = t->canvas;
+		int x1 = t->cv_x;
+		int y1 = t->cv_y;
+		int x2 = t->cv_x + t->e.w - 1;
+		int y2 = t->cv_y + t->e.h - 1;
+		wattrset(c, _tilestyle(t, style));
+		mvwhline(c, y1, x1+1, 0, t->e.w - 2);
+		mvwhline(c, y2, x1+1, 0, t->e.w - 2);
+		mvwvline(c, y1+1, x1, 0, t->e.h - 2);
+		mvwvline(c, y1+1, x2, 0, t->e.h - 2);
+		mvwaddch(c, y1, x1, ACS_ULCORNER);
+		mvwaddch(c, y1, x2, ACS_URCORNER);
+		mvwaddch(c, y2, x1, ACS_LLCORNER);
+		return mvwaddch(c, y2, x2, ACS_LRCORNER);
+	}
+
 	wattrset(t->ncwin, _tilestyle(t, style));
 	return box(t->ncwin, 0, 0);
 }
 
+// -----------------------------------------------------------------------
+int emuibgchanged(EMTILE *t, int style)
+{
+	chtype bg = _tilestyle(t, style);
+
+	return (getbkgd(t->ncwin) & A_ATTRIBUTES) != (bg & A_ATTRIBUTES);
+}
+
 // -----------------------------------------------------------------------
 int emuifillbg(EMTILE *t, int style)
 {
+	if (t->canvas) {
+		// shared window's background and attributes are restored after
+		// the tile is drawn. Blanks are rendered with current attributes
+		// mixed in, so they need to be reset too.
+		wbkgdset(t->canvas, _tilestyle(t, style));
+		wattrset(t->canvas, _tilestyle(t, style));
+		for (int y=0 ; y<t->e.h ; y++) {
+			mvwhline(t->canvas, t->cv_y + y, t->cv_x, ' ', t->e.w);
+		}
+		return 1;
+	}
+
 	wbkgd(t->ncwin, _tilestyle(t, style));
 	return 1;
 }
@@ -81,6 +208,15 @@ int emuifillbg(EMTILE *t, int style)
 // -----------------------------------------------------------------------
 int emuihline(EMTILE *t, int x, int y, int len, int style)
 {
+	if (t->canvas) {
+		if ((x < 0) || (y < 0) || (x >= t->e.w) || (y >= t->e.h)) {
+			return ERR;
+		}
+		if (len > t->e.w - x) len = t->e.w - x;
+		wattrset(t->canvas, _tilestyle(t, style));
+		return mvwhline(t->canvas, t->cv_y + y, t->cv_x + x, 0, len);
+	}
+
 	wattrset(t->ncwin, _tilestyle(t, style));
 	return mvwhline(t->ncwin, y, x, 0, len);
 }
@@ -88,6 +224,15 @@ int emuihline(EMTILE *t, int x, int y, int len, int style)
 // -----------------------------------------------------------------------
 int emuivline(EMTILE *t, int x, int y, int len, int style)
 {
+	if (t->canvas) {
+		if ((x < 0) || (y < 0) || (x >= t->e.w) || (y >= t->e.h)) {
+			return ERR;
+		}
+		if (len > t->e.h - y) len = t->e.h - y;
+		wattrset(t->canvas, _tilestyle(t, style));
+		return mvwvline(t->canvas, t->cv_y + y, t->cv_x + x, 0, len);
+	}
+
 	wattrset(t->ncwin, _tilestyle(t, style));
 	return mvwvline(t->ncwin, y, x, 0, len);
 }
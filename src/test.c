@@ -99,9 +99,11 @@ Status bar indicators:\n\
 ";
 
 #define MAX_MEM 1024*32
+#define MEMV_COLS 16
 
 EMTILE *tabs;
 EMTILE *help;
+EMKEYMAP *dasmv_keymap;
 
 uint16_t treg[8];
 struct emdas *emd;
@@ -302,6 +304,22 @@ EMTILE * ui_create_ureg(EMTILE *parent)
 	return ureg;
 }
 
+// -----------------------------------------------------------------------
+EMTILE * memv_cell_new(EMTILE *vgrid)
+{
+	EMTILE *l = emui_lineedit(vgrid, 0, 0, 4, 4, TT_HEX, M_OVR);
+	emtile_set_change_handler(l, reg_int_changed);
+	emtile_set_update_handler(l, reg_int_update);
+
+	return l;
+}
+
+// -----------------------------------------------------------------------
+void memv_cell(EMTILE *vgrid, EMTILE *cell, int row, int col)
+{
+	emtile_set_ptr(cell, mem[2] + row * MEMV_COLS + col);
+}
+
 // -----------------------------------------------------------------------
 EMTILE * ui_create_sreg(EMTILE *parent)
 {
@@ -374,67 +392,103 @@ static int dasm_update(EMTILE *t)
 }
 
 // -----------------------------------------------------------------------
-int dasmv_key_handler(EMTILE *t, int key)
+int dasm_move(EMTILE *t, int lines)
 {
-	switch (key) {
-	case KEY_UP:
-		dasm_start--;
-		return E_HANDLED;
-	case KEY_DOWN:
-		dasm_start++;
-		return E_HANDLED;
-	case KEY_PPAGE:
-		dasm_start -= t->i.h;
-		return E_HANDLED;
-	case KEY_NPAGE:
-		dasm_start += t->i.h;
-		return E_HANDLED;
-	case KEY_HOME:
-		dasm_start = 0;
-		return E_HANDLED;
-	case KEY_END:
-		dasm_start = 0x10000 - t->i.h;
-		return E_HANDLED;
-	case 550: // ctrl-page up
-	case '<':
-	case ',':
-		dasm_start = (dasm_start - 0x1000) & 0xffff;
-		return E_HANDLED;
-	case 545: // ctrl-page down
-	case '>':
-	case '.':
-		dasm_start = (dasm_start + 0x1000) & 0xffff;
-		return E_HANDLED;
-	case KEY_RIGHT:
-		dasm_segment = (dasm_segment+1) & 0xf;
-		return E_HANDLED;
-	case KEY_LEFT:
-		dasm_segment = (dasm_segment-1) & 0xf;
-		return E_HANDLED;
-	case '0':
-	case '1':
-	case '2':
-	case '3':
-	case '4':
-	case '5':
-	case '6':
-	case '7':
-	case '8':
-	case '9':
-		dasm_segment = key - '0';
-		return E_HANDLED;
-	case 'f':
-		dasm_follow ^= 1;
-		return E_HANDLED;
-	case 'i':
-		// TODO: current IC
-		return E_HANDLED;
+	dasm_start += lines;
+	return E_HANDLED;
+}
 
-	}
+// -----------------------------------------------------------------------
+int dasm_page(EMTILE *t, int pages)
+{
+	dasm_start += pages * t->i.h;
+	return E_HANDLED;
+}
 
-	return E_UNHANDLED;
+// -----------------------------------------------------------------------
+int dasm_home(EMTILE *t, int arg)
+{
+	dasm_start = 0;
+	return E_HANDLED;
+}
+
+// -----------------------------------------------------------------------
+int dasm_end(EMTILE *t, int arg)
+{
+	dasm_start = 0x10000 - t->i.h;
+	return E_HANDLED;
+}
+
+// -----------------------------------------------------------------------
+int dasm_mem_page(EMTILE *t, int pages)
+{
+	dasm_start = (dasm_start + pages * 0x1000) & 0xffff;
+	return E_HANDLED;
+}
+
+// -----------------------------------------------------------------------
+int dasm_segment_move(EMTILE *t, int segments)
+{
+	dasm_segment = (dasm_segment + segments) & 0xf;
+	return E_HANDLED;
+}
+
+// -----------------------------------------------------------------------
+int dasm_segment_set(EMTILE *t, int segment)
+{
+	dasm_segment = segment;
+	return E_HANDLED;
+}
+
+// -----------------------------------------------------------------------
+int dasm_follow_toggle(EMTILE *t, int arg)
+{
+	dasm_follow ^= 1;
+	return E_HANDLED;
+}
+
+// -----------------------------------------------------------------------
+int dasm_ic(EMTILE *t, int arg)
+{
+	// TODO: current IC
+	return E_HANDLED;
 }
 
+static struct emui_keybinding dasmv_keys[] = {
+	{ "Up",		dasm_move,			-1 },
+	{ "Down",	dasm_move,			1 },
+	{ "PgUp",	dasm_page,			-1 },
+	{ "PgDn",	dasm_page,			1 },
+	{ "Home",	dasm_home,			0 },
+	{ "End",	dasm_end,			0 },
+	{ "<",		dasm_mem_page,		-1 },
+	{ ",",		dasm_mem_page,		-1 },
+	{ ">",		dasm_mem_page,		1 },
+	{ ".",		dasm_mem_page,		1 },
+	{ "Right",	dasm_segment_move,	1 },
+	{ "Left",	dasm_segment_move,	-1 },
+	{ "0",		dasm_segment_set,	0 },
+	{ "1",		dasm_segment_set,	1 },
+	{ "2",		dasm_segment_set,	2 },
+	{ "3",		dasm_segment_set,	3 },
+	{ "4",		dasm_segment_set,	4 },
+	{ "5",		dasm_segment_set,	5 },
+	{ "6",		dasm_segment_set,	6 },
+	{ "7",		dasm_segment_set,	7 },
+	{ "8",		dasm_segment_set,	8 },
+	{ "9",		dasm_segment_set,	9 },
+	{ "f",		dasm_follow_toggle,	0 },
+	{ "i",		dasm_ic,			0 },
+	{ NULL,		NULL,				0 }
+};
+
+// keys that not every terminal has, loaded separately
+static struct emui_keybinding dasmv_term_keys[] = {
+	{ "C-PgUp",	dasm_mem_page,		-1 },
+	{ "C-PgDn",	dasm_mem_page,		1 },
+	{ NULL,		NULL,				0 }
+};
+
 // -----------------------------------------------------------------------
 struct goto_data {
 	int *seg;
@@ -519,6 +573,7 @@ EMTILE * dialog_goto(EMTILE *parent, int *seg, uint16_t *addr)
 
 	EMTILE *dlg = emui_frame(parent, 0, 0, 24, 3, "GoTo", P_CENTER);
 	emtile_set_geometry_parent(dlg, parent, GEOM_INTERNAL);
+	emtile_set_layer(dlg, Z_DIALOG);
 
 	emui_label(dlg, 1, 0, 9, S_DEFAULT, "Address: ");
 	dat->le = emui_lineedit(dlg, 10, 0, 10, 10, TT_TEXT, M_INS);
@@ -555,6 +610,36 @@ static int dasm_status_update(EMTILE *t)
 	return E_UPDATED;
 }
 
+// breakpoint row: number, condition
+char *brk_row =
+	"dummy 0 0 30 1 props=P_HMAXIMIZE\n"
+	"	label 0 0 4 S_DEFAULT \"\" slot=0\n"
+	"	lineedit 4 0 100 100 TT_TEXT M_INS\n";
+
+// watch row: watch expression gives way first, then type labels
+char *watch_row =
+	"dummy 0 0 30 1 props=P_HMAXIMIZE\n"
+	"	flex AL_HORIZONTAL\n"
+	"		lineedit 4 0 100 100 TT_TEXT M_INS hint=1,0,1,0 slot=0\n"
+	"		label 0 0 6 1 \"hex\" hint=6,6,0,1\n"
+	"		label 0 0 6 1 \"int\" hint=6,6,0,2\n";
+
+// -----------------------------------------------------------------------
+void brk_row_bind(EMTILE *t, EMTILE **slots, int idx, void *ptr)
+{
+	EMTEXT *txt = emui_label_get_emtext(slots[0]);
+	emtext_clear(txt);
+	emtext_append_str(txt, S_DEFAULT, "%3i:", idx);
+}
+
+// -----------------------------------------------------------------------
+void watch_row_bind(EMTILE *t, EMTILE **slots, int idx, void *ptr)
+{
+	char str[32];
+	sprintf(str, "watch_%i", idx);
+	emui_lineedit_set_text(slots[0], str);
+}
+
 // -----------------------------------------------------------------------
 EMTILE * ui_create_debugger(EMTILE *parent)
 {
@@ -568,7 +653,13 @@ EMTILE * ui_create_debugger(EMTILE *parent)
 	EMTILE *asmv = emui_textview(dasm, 0, 0, 30, 20);
 	emtile_set_properties(asmv, P_MAXIMIZE);
 	emtile_set_key_handler(dasm, dasm_key_handler);
-	emtile_set_key_handler(asmv, dasmv_key_handler);
+	dasmv_keymap = emkeymap();
+	if (emkeymap_load(dasmv_keymap, dasmv_keys)) {
+		return NULL;
+	}
+	// "<" and ">" do the same if the terminal doesn't know these
+	emkeymap_load(dasmv_keymap, dasmv_term_keys);
+	emtile_set_keymap(asmv, dasmv_keymap);
 	emtile_set_update_handler(asmv, dasm_update);
 
 	// asm status
@@ -601,7 +692,7 @@ EMTILE * ui_create_debugger(EMTILE *parent)
 	emui_label(mem, 1, 0, 6, S_DEFAULT, "seg 2");
 
 	char buf[5];
-	for (int i=0 ; i<32 ; i++) {
+	for (int i=0 ; i<MEMV_COLS ; i++) {
 		sprintf(buf, "%x", i);
 		emui_label(mem, 9+i*5, 0, 4, S_DEFAULT, buf);
 	}
@@ -613,13 +704,7 @@ EMTILE * ui_create_debugger(EMTILE *parent)
 	}
 
 	EMTILE *memv_cont = emui_dummy_cont(mem, 9, 2, 1000, 1000);
-	EMTILE *memv = emui_grid(memv_cont, -1, -1, 4, 1, 1);
-
-	for (int i=0 ; i<1000 ; i++) {
-		sprintf(buf, "%x", i);
-		EMTILE *l = emui_lineedit(memv, 0, 0, 4, 4, TT_HEX, M_OVR);
-		emui_lineedit_set_text(l, buf);
-	}
+	emui_vgrid(memv_cont, MAX_MEM/MEMV_COLS, MEMV_COLS, 4, 1, 1, memv_cell_new, memv_cell);
 
 	// eval
 	EMTILE *eval_split = emui_splitter(mem_split, AL_BOTTOM, 3, 3, 10);
@@ -633,30 +718,15 @@ EMTILE * ui_create_debugger(EMTILE *parent)
 	EMTILE *brk = emui_frame(watch_split, 0, 0, 25, 10, "Breakpoints", P_CENTER);
 	emtile_set_focus_key(brk, 'b');
 	EMTILE *brklist = emui_list(brk);
-	for (int i=0 ; i<20 ; i++) {
-		EMTILE *brkc = emui_dummy_cont(brklist, 0, i, 30, 1);
-		emtile_set_properties(brkc, P_HMAXIMIZE);
-		char str[32];
-		sprintf(str, "%3i:", i);
-		emui_label(brkc, 0, 0, 4, S_DEFAULT, str);
-		emui_lineedit(brkc, 4, 0, 100, 100, TT_TEXT, M_INS);
-
-	}
+	EMTPL *brk_tpl = emui_template(brk_row, NULL);
+	emui_template_instantiate(brk_tpl, brklist, 20, brk_row_bind, NULL);
+	emui_template_delete(brk_tpl);
 	EMTILE *watch = emui_frame(watch_split, 0, 0, 30, 10, "Watches", P_CENTER);
 	emtile_set_focus_key(watch, 'w');
 	EMTILE *watchlist = emui_list(watch);
-	for (int i=0 ; i<20 ; i++) {
-		EMTILE *wc = emui_dummy_cont(watchlist, 0, i, 30, 1);
-		emtile_set_properties(wc, P_HMAXIMIZE);
-		EMTILE *ws = emui_splitter(wc, AL_RIGHT, 6, 6, FIT_FILL);
-		emui_label(ws, 0, 0, 6, 1, "int");
-		EMTILE *ws2 = emui_splitter(ws, AL_RIGHT, 6, 6, FIT_FILL);
-		emui_label(ws2, 0, 0, 6, 1, "hex");
-		char str[32];
-		sprintf(str, "watch_%i", i);
-		EMTILE *l = emui_lineedit(ws2, 4, 0, 100, 100, TT_TEXT, M_INS);
-		emui_lineedit_set_text(l, str);
-	}
+	EMTPL *watch_tpl = emui_template(watch_row, NULL);
+	emui_template_instantiate(watch_tpl, watchlist, 20, watch_row_bind, NULL);
+	emui_template_delete(watch_tpl);
 
 	// memory
 
@@ -671,26 +741,23 @@ int help_key_handler(EMTILE *t, int key)
 }
 
 // -----------------------------------------------------------------------
-int top_key_handler(EMTILE *t, int key)
+int help_open(EMTILE *t, struct emui_event *ev)
 {
 	EMTILE *help_tv;
 
-	switch (key) {
-	case 'h':
-	case '?':
-	case 'H':
-		help = emui_frame(t, 1, 1, 60, 20, "Help", P_VMAXIMIZE | P_HCENTER);
-		emtile_set_geometry_parent(help, tabs, GEOM_INTERNAL);
-		emtile_set_key_handler(help, help_key_handler);
-		help_tv = emui_textview(help, 0, 0, 10, 10);
-		emtile_set_properties(help_tv, P_MAXIMIZE);
-		emtext_append_str(emui_textview_get_emtext(help_tv), S_DEFAULT, "%s", help_text);
-
-		emui_focus(help);
-		return E_HANDLED;
-	}
+	help = emui_frame(t, 1, 1, 60, 20, "Help", P_VMAXIMIZE | P_HCENTER);
+	emtile_set_geometry_parent(help, tabs, GEOM_INTERNAL);
+	emtile_set_layer(help, Z_DIALOG);
+	emtile_set_key_handler(help, help_key_handler);
+	// help comes and goes as a whole
+	emtile_set_arena(help, 0);
+	help_tv = emui_textview(help, 0, 0, 10, 10);
+	emtile_set_properties(help_tv, P_MAXIMIZE);
+	emtext_append_str(emui_textview_get_emtext(help_tv), S_DEFAULT, "%s", help_text);
 
-	return E_UNHANDLED;
+	emui_focus(help);
+
+	return E_HANDLED;
 }
 
 // -----------------------------------------------------------------------
@@ -720,7 +787,12 @@ int main(int argc, char **argv)
 	EMTILE *layout = emui_init(30);
 
 	emui_scheme_set(app_scheme);
-	emtile_set_key_handler(layout, top_key_handler);
+	emui_connect(layout, EV_KEY, 'h', help_open);
+	emui_connect(layout, EV_KEY, '?', help_open);
+	emui_connect(layout, EV_KEY, 'H', help_open);
+
+	// build the whole UI first, lay it out once
+	emui_batch_begin();
 
 	// status
 	EMTILE *status_split = emui_splitter(layout, AL_BOTTOM, 1, 1, FIT_FILL);
@@ -745,11 +817,20 @@ int main(int argc, char **argv)
 
 	// debugger
 	EMTILE *debugger = ui_create_debugger(tabs);
+	if (!debugger) {
+		emui_destroy();
+		emkeymap_delete(dasmv_keymap);
+		emdas_destroy(emd);
+		exit(1);
+	}
 
 	emui_focus(debugger);
 
+	emui_batch_commit();
+
 	emui_loop();
 	emui_destroy();
+	emkeymap_delete(dasmv_keymap);
 	emdas_destroy(emd);
 
 	return 0;
@@ -26,9 +26,38 @@
 #include "style.h"
 #include "focus.h"
 #include "print.h"
+#include "hitmap.h"
+#include "connect.h"
+#include "keymap.h"
+#include "alloc.h"
+#include "tiletab.h"
+#include "winpool.h"
+#include "fgindex.h"
+#include "tilepath.h"
+#include "lcache.h"
+#include "compose.h"
 
 static void emtile_child_append(EMTILE *parent, EMTILE *t);
 
+// Tiles deleted with emtile_delete() are queued and physically deleted
+// all at once, before the next frame is drawn
+static EMTILE **del_queue;
+static int del_count, del_size;
+
+static int fit_deferred;
+
+// Tiles and their (fixed-size) private data come from slabs, so they sit
+// close together in memory and are cheap to create and drop.
+// Subtrees that come and go as a whole (dialogs) may get an arena
+// with emtile_set_arena(). All descendants of such tile are then allocated
+// from the arena, which is released in one step with the tile.
+
+#define PRIV_SLAB_GRAIN 16
+#define PRIV_SLAB_CLASSES 16
+
+static EMSLAB *tile_slab;
+static EMSLAB *priv_slabs[PRIV_SLAB_CLASSES];
+
 // -----------------------------------------------------------------------
 static void emtile_fit_parent(EMTILE *t)
 {
@@ -122,32 +151,129 @@ static void emtile_fit_interior(EMTILE *t)
 }
 
 // -----------------------------------------------------------------------
-void emtile_fit(EMTILE *t)
+static void emtile_fit_inputs(EMTILE *t, struct emui_fit_inputs *fi)
 {
-	if (t->parent) {
-		EDBG(t, 1, "fitting tile");
+	memset(fi, 0, sizeof(struct emui_fit_inputs));
+	if (t->pg) fi->pg = *t->pg;
+	fi->r = t->r;
+	fi->e = t->e;
+	fi->mt = t->mt;
+	fi->mb = t->mb;
+	fi->ml = t->ml;
+	fi->mr = t->mr;
+	fi->properties = t->properties;
+	if (t->parent) fi->parent_properties = t->parent->properties;
+}
 
-		emtile_fit_parent(t);
-		emtile_fit_interior(t);
+// -----------------------------------------------------------------------
+int emtile_fit_needed(EMTILE *t)
+{
+	struct emui_fit_inputs fi;
 
-		// if tile is visible, prepare ncurses window
-		if (!(t->properties & P_HIDDEN)) {
-			// prepare ncurses window
-			if (!(t->properties & P_NOCANVAS)) {
-				if (!t->ncwin) {
-					t->ncwin = newwin(t->e.h, t->e.w, t->e.y, t->e.x);
-				} else {
-					werase(t->ncwin);
-					wresize(t->ncwin, t->e.h, t->e.w);
-					mvwin(t->ncwin, t->e.y, t->e.x);
-				}
-			}
-			// tile is inversed if parent is inversed
-			if (t->parent->properties & P_INVERSE) {
-				t->properties |= P_INVERSE;
+	if (t->geometry_changed) return 1;
+
+	// fitting the tile again would give the same result
+	// if nothing that tile geometry depends on has changed
+	emtile_fit_inputs(t, &fi);
+
+	return memcmp(&fi, &t->fi, sizeof(struct emui_fit_inputs)) ? 1 : 0;
+}
+
+// -----------------------------------------------------------------------
+EMTILE * _emtile_visit_first(EMTILE *t, struct emtile_visit *v)
+{
+	// containers with lots of children may know which ones need a visit
+	v->tiles = t->drv->visited_children ? t->drv->visited_children(t, &v->count) : NULL;
+	v->pos = 0;
+	v->next = t->ch_first;
+
+	return _emtile_visit_next(v);
+}
+
+// -----------------------------------------------------------------------
+EMTILE * _emtile_visit_next(struct emtile_visit *v)
+{
+	if (v->tiles) {
+		return v->pos < v->count ? v->tiles[v->pos++] : NULL;
+	}
+
+	EMTILE *ch = v->next;
+	if (ch) {
+		v->next = ch->ch_next;
+	}
+
+	return ch;
+}
+
+// -----------------------------------------------------------------------
+static int emtile_win_matches(EMTILE *t)
+{
+	int x, y, w, h;
+
+	getbegyx(t->ncwin, y, x);
+	getmaxyx(t->ncwin, h, w);
+
+	return (x == t->e.x) && (y == t->e.y) && (w == t->e.w) && (h == t->e.h);
+}
+
+// -----------------------------------------------------------------------
+static int emtile_fit_window(EMTILE *t)
+{
+	int ret = E_UNCHANGED;
+
+	// if tile is visible, prepare ncurses window
+	if (!(t->properties & P_HIDDEN)) {
+		// prepare ncurses window
+		if (!(t->properties & P_NOCANVAS)) {
+			// window is created when the tile is drawn
+			if (!t->ncwin) {
+				ret = E_UPDATED;
+			// leave window (and its contents) alone if it didn't move
+			} else if (!emtile_win_matches(t)) {
+				werase(t->ncwin);
+				wresize(t->ncwin, t->e.h, t->e.w);
+				mvwin(t->ncwin, t->e.y, t->e.x);
+				ret = E_UPDATED;
+			// tile is shown again, window needs to be copied to the screen
+			} else if (t->fi.properties & P_HIDDEN) {
+				touchwin(t->ncwin);
+				ret = E_UPDATED;
 			}
+		}
+		if (t->ncwin && (emuibgchanged(t, t->style) || (ret == E_UPDATED))) {
 			emuifillbg(t, t->style);
+			ret = E_UPDATED;
 		}
+	// hidden tile doesn't need a window, give it back to the pool
+	} else if (t->ncwin) {
+		emui_winpool_put(t->ncwin);
+		t->ncwin = NULL;
+	}
+
+	return ret;
+}
+
+// -----------------------------------------------------------------------
+static void emtile_fit_inverse(EMTILE *t)
+{
+	// tile is inversed if parent is inversed
+	if (!(t->properties & P_HIDDEN) && (t->parent->properties & P_INVERSE)) {
+		t->properties |= P_INVERSE;
+	}
+}
+
+// -----------------------------------------------------------------------
+void _emtile_fit_geometry(EMTILE *t)
+{
+	// Geometry part of emtile_fit(): touches only the tile and its children,
+	// as long as the driver is marked with pure_geometry. Layout pool runs it
+	// outside the main thread only for such drivers (and tiles without one)
+	if (t->parent) {
+		EDBG(t, 1, "fitting tile");
+
+		emtile_fit_parent(t);
+		emtile_fit_interior(t);
+		emtile_fit_inverse(t);
 	}
 
 	EDBG(t, 1, "doing tile specific geometry update");
@@ -156,8 +282,134 @@ void emtile_fit(EMTILE *t)
 	if (t->drv->update_children_geometry) {
 		t->drv->update_children_geometry(t);
 	}
+}
+
+// -----------------------------------------------------------------------
+int _emtile_fit_finish(EMTILE *t, struct emui_geom *old_i)
+{
+	int ret = E_UNCHANGED;
+
+	if (t->parent) {
+		ret = emtile_fit_window(t);
+		if (ret == E_UPDATED) {
+			t->erased = 1;
+		}
+	}
+
+	// keep the hit map and focus group index in sync with the new geometry
+	emui_hitmap_update(t);
+	if (memcmp(old_i, &t->i, sizeof(struct emui_geom))) {
+		emui_fgindex_update(t);
+	}
+
+	emtile_fit_inputs(t, &t->fi);
+	t->geometry_changed = 0;
+	emui_tiletab_update(t);
+
+	return ret;
+}
+
+// -----------------------------------------------------------------------
+int emtile_fit(EMTILE *t)
+{
+	struct emui_geom i = t->i;
+
+	_emtile_fit_geometry(t);
+
+	return _emtile_fit_finish(t, &i);
+}
+
+// -----------------------------------------------------------------------
+int _emtile_restore_geometry(EMTILE *t, struct emui_geom *e, struct emui_geom *i, struct emui_fit_inputs *fi)
+{
+	int ret = E_UNCHANGED;
+	struct emui_geom oi = t->i;
+
+	EDBG(t, 1, "restoring tile geometry");
+
+	// same as emtile_fit(), but with the result known upfront
+	t->e = *e;
+	t->i = *i;
+	t->properties = (t->properties & ~P_HIDDEN) | (fi->properties & P_HIDDEN);
+
+	if (t->parent) {
+		emtile_fit_inverse(t);
+		ret = emtile_fit_window(t);
+	}
 
+	emui_hitmap_update(t);
+	if (memcmp(&oi, &t->i, sizeof(struct emui_geom))) {
+		emui_fgindex_update(t);
+	}
+
+	t->fi = *fi;
 	t->geometry_changed = 0;
+	emui_tiletab_update(t);
+
+	return ret;
+}
+
+// -----------------------------------------------------------------------
+static EMTILE * emtile_canvas_owner(EMTILE *t)
+{
+	int x, y, w, h;
+
+	// floating tiles are drawn over others, they need own window
+	if (!(t->properties & P_SHARED_CANVAS) || (t->properties & P_FLOAT)) {
+		return NULL;
+	}
+
+	EMTILE *o = t->parent;
+	while (o && (!o->ncwin || (o->properties & P_SHARED_CANVAS))) {
+		o = o->parent;
+	}
+	if (!o) return NULL;
+
+	// tile needs to be within the window
+	getbegyx(o->ncwin, y, x);
+	getmaxyx(o->ncwin, h, w);
+	if ((t->e.x < x) || (t->e.y < y) || (t->e.x + t->e.w > x + w) || (t->e.y + t->e.h > y + h)) {
+		return NULL;
+	}
+
+	return o;
+}
+
+// -----------------------------------------------------------------------
+static void emtile_draw_shared(EMTILE *t, EMTILE *o)
+{
+	WINDOW *win = o->ncwin;
+	chtype bg = getbkgd(win);
+	attr_t attrs;
+	short pair;
+	int x, y;
+
+	wattr_get(win, &attrs, &pair, NULL);
+
+	// window isn't needed when drawing into the shared one
+	if (t->ncwin) {
+		emui_winpool_put(t->ncwin);
+		t->ncwin = NULL;
+	}
+
+	getbegyx(win, y, x);
+	t->canvas = win;
+	t->cv_x = t->e.x - x;
+	t->cv_y = t->e.y - y;
+	t->cur_x = t->cur_y = 0;
+
+	// area is cleared, as tile's own window would be after fit
+	emuifillbg(t, t->style);
+	if (t->drv->draw) t->drv->draw(t);
+
+	// leave window cursor where tile has left its cursor
+	wmove(win, t->cv_y + (t->cur_y < t->e.h ? t->cur_y : t->e.h - 1), t->cv_x + t->cur_x);
+	wbkgdset(win, bg);
+	wattr_set(win, attrs, pair, NULL);
+	t->canvas = NULL;
+
+	// only cells changed by the tile are copied
+	wnoutrefresh(win);
 }
 
 // -----------------------------------------------------------------------
@@ -174,6 +426,19 @@ void emtile_draw(EMTILE *t)
 		t->update_handler(t);
 	}
 
+	EMTILE *o = emtile_canvas_owner(t);
+	if (o) {
+		emtile_draw_shared(t, o);
+		return;
+	}
+
+	// get a window when the tile is drawn for the first time after being hidden
+	if (!t->ncwin) {
+		t->ncwin = emui_winpool_get(t->e.h, t->e.w, t->e.y, t->e.x);
+		if (!t->ncwin) return;
+		emuifillbg(t, t->style);
+	}
+
 	// draw the tile
 	if (t->drv->draw) t->drv->draw(t);
 
@@ -182,18 +447,32 @@ void emtile_draw(EMTILE *t)
 	wnoutrefresh(t->ncwin);
 }
 
+// -----------------------------------------------------------------------
+void _emtile_place_cursor(EMTILE *t)
+{
+	// screen cursor ends up where the last copied window has its cursor
+	if (!t || (t->properties & (P_HIDDEN | P_NOCANVAS)) || t->occluded) {
+		return;
+	}
+
+	EMTILE *o = emtile_canvas_owner(t);
+	if (o) {
+		wmove(o->ncwin, t->cv_y + (t->cur_y < t->e.h ? t->cur_y : t->e.h - 1), t->cv_x + t->cur_x);
+		wnoutrefresh(o->ncwin);
+	} else if (t->ncwin) {
+		wnoutrefresh(t->ncwin);
+	}
+}
+
 // -----------------------------------------------------------------------
 static int emtile_focus_keys(EMTILE *fg, int key)
 {
-	EMTILE *t = fg->fg_first;
+	EMTILE *t = emui_focus_key_get(fg, key);
 
-	while (t) {
-		if (t->key == key) {
-			EDBG(t, 3, "Focus key %c matches", key);
-			emui_focus(t);
-			return E_HANDLED;
-		}
-		t = t->fg_next;
+	if (t) {
+		EDBG(t, 3, "Focus key %c matches", key);
+		emui_focus(t);
+		return E_HANDLED;
 	}
 
 	return E_UNHANDLED;
@@ -217,65 +496,96 @@ static int _distance(int x1, int y1, int x2, int y2)
 }
 
 // -----------------------------------------------------------------------
-EMTILE * emtile_get_physical_neighbour(EMTILE *fg, int dir, unsigned prop_match, unsigned prop_nomatch)
+static void _physical_neighbour_consider(EMTILE *t, EMTILE *f, int dir, int *ovrl_max, int *dist_min, EMTILE **match)
 {
-	EMTILE *t = emui_subfocus_get(fg);
-	EMTILE *f = fg->fg_first;
-	EMTILE *match = t;
-
 	int dd; // directional distance (distance in the move direction)
-	int ovrl, ovrl_max = 0; // overlap region
-	int dist, dist_min = INT_MAX;
-
-	while (f) {
-		if ((f->properties & (prop_match | prop_nomatch)) == prop_match) {
-			EDBG(f, 3, "considering phys. neigh.: %i,%i (%i,%i)", f->i.x, f->i.y, f->i.h, f->i.w);
-			switch (dir) {
-				case FC_ABOVE:
-					dd = t->i.y - f->i.y - f->i.h;
-					ovrl = _overlap(t->i.x, t->i.x + t->i.w, f->i.x, f->i.x + f->i.w);
-					break;
-				case FC_BELOW:
-					dd = f->i.y - t->i.y - t->i.h;
-					ovrl = _overlap(t->i.x, t->i.x + t->i.w, f->i.x, f->i.x + f->i.w);
-					break;
-				case FC_LEFT:
-					dd = t->i.x - f->i.x - f->i.w;
-					ovrl = _overlap(t->i.y, t->i.y + t->i.h, f->i.y, f->i.y + f->i.h);
-					break;
-				case FC_RIGHT:
-					dd = f->i.x - t->i.x - t->i.w;
-					ovrl = _overlap(t->i.y, t->i.y + t->i.h, f->i.y, f->i.y + f->i.h);
-					break;
-				default:
-					return t; // unknown or incompatibile direction
+	int ovrl; // overlap region
+	int dist;
+
+	EDBG(f, 3, "considering phys. neigh.: %i,%i (%i,%i)", f->i.x, f->i.y, f->i.h, f->i.w);
+	switch (dir) {
+		case FC_ABOVE:
+			dd = t->i.y - f->i.y - f->i.h;
+			ovrl = _overlap(t->i.x, t->i.x + t->i.w, f->i.x, f->i.x + f->i.w);
+			break;
+		case FC_BELOW:
+			dd = f->i.y - t->i.y - t->i.h;
+			ovrl = _overlap(t->i.x, t->i.x + t->i.w, f->i.x, f->i.x + f->i.w);
+			break;
+		case FC_LEFT:
+			dd = t->i.x - f->i.x - f->i.w;
+			ovrl = _overlap(t->i.y, t->i.y + t->i.h, f->i.y, f->i.y + f->i.h);
+			break;
+		case FC_RIGHT:
+		default:
+			dd = f->i.x - t->i.x - t->i.w;
+			ovrl = _overlap(t->i.y, t->i.y + t->i.h, f->i.y, f->i.y + f->i.h);
+			break;
+	}
+
+	dist = _distance(t->i.x+t->i.w/2, t->i.y+t->i.h/2, f->i.x+f->i.w/2, f->i.y+f->i.h/2);
+
+	// tile has to be:
+	//  * other than the current tile
+	//  * further in the move direction
+	//  * "overlapping" with current tile in axis perpendicural to movement
+	if ((f != t) && (dd >= 0) && (ovrl > 0)) {
+		// we search for the closest tile
+		if (dist <= *dist_min) {
+			// we search for a tile that "overlaps" the most with the current one
+			if (ovrl >= *ovrl_max) {
+				*ovrl_max = ovrl/2; // /2 => less impact on decision
+				*dist_min = dist;
+				*match = f;
+				EDBG(f, 3, "best so far");
 			}
+		}
+	}
+}
 
-			dist = _distance(t->i.x+t->i.w/2, t->i.y+t->i.h/2, f->i.x+f->i.w/2, f->i.y+f->i.h/2);
-
-			// tile has to be:
-			//  * other than the current tile
-			//  * further in the move direction
-			//  * "overlapping" with current tile in axis perpendicural to movement
-			if ((f != t) && (dd >= 0) && (ovrl > 0)) {
-				// we search for the closest tile
-				if (dist <= dist_min) {
-					// we search for a tile that "overlaps" the most with the current one
-					if (ovrl >= ovrl_max) {
-						ovrl_max = ovrl/2; // /2 => less impact on decision
-						dist_min = dist;
-						match = f;
-						EDBG(match, 3, "best so far");
-					}
-				}
+// -----------------------------------------------------------------------
+EMTILE * emtile_get_physical_neighbour_from(EMTILE *fg, EMTILE *t, int dir, unsigned prop_match, unsigned prop_nomatch)
+{
+	EMTILE *match = t;
+	EMTILE **cand;
+	int ovrl_max = 0;
+	int dist_min = INT_MAX;
+
+	if ((dir != FC_ABOVE) && (dir != FC_BELOW) && (dir != FC_LEFT) && (dir != FC_RIGHT)) {
+		return t; // unknown or incompatibile direction
+	}
+
+	// Only members overlapping the current tile in axis perpendicular
+	// to the movement can be picked. Other members never change
+	// the search state, so checking just the ones the index returns
+	// (in focus group order) gives the same result as checking all.
+	int count = emui_fgindex_query(fg, t, dir, &cand);
+
+	if (count >= 0) {
+		for (int i=0 ; i<count ; i++) {
+			EMTILE *f = cand[i];
+			if ((f->properties & (prop_match | prop_nomatch)) == prop_match) {
+				_physical_neighbour_consider(t, f, dir, &ovrl_max, &dist_min, &match);
+			}
+		}
+	// no index (out of memory), check the whole group
+	} else {
+		for (EMTILE *f=fg->fg_first ; f ; f=f->fg_next) {
+			if ((f->properties & (prop_match | prop_nomatch)) == prop_match) {
+				_physical_neighbour_consider(t, f, dir, &ovrl_max, &dist_min, &match);
 			}
 		}
-		f = f->fg_next;
 	}
 
 	return match;
 }
 
+// -----------------------------------------------------------------------
+EMTILE * emtile_get_physical_neighbour(EMTILE *fg, int dir, unsigned prop_match, unsigned prop_nomatch)
+{
+	return emtile_get_physical_neighbour_from(fg, emui_subfocus_get(fg), dir, prop_match, prop_nomatch);
+}
+
 // -----------------------------------------------------------------------
 EMTILE * emtile_get_list_neighbour(EMTILE *fg, int dir, unsigned prop_match, unsigned prop_nomatch)
 {
@@ -379,6 +689,22 @@ static int emtile_neighbour_focus(EMTILE *fg, int key)
 // -----------------------------------------------------------------------
 int emtile_event(EMTILE *t, struct emui_event *ev)
 {
+	// try handlers connected to the tile
+	if (t->connections && (emui_connection_run(t, ev) == E_HANDLED)) {
+		return E_HANDLED;
+	}
+
+	return emtile_event_handlers(t, ev);
+}
+
+// -----------------------------------------------------------------------
+int emtile_event_handlers(EMTILE *t, struct emui_event *ev)
+{
+	// try app key bindings
+	if ((ev->type == EV_KEY) && t->keymap && (emkeymap_feed(t->keymap, t, ev->sender) == E_HANDLED)) {
+		return E_HANDLED;
+	}
+
 	// try running app key handler
 	if ((ev->type == EV_KEY) && t->key_handler && (t->key_handler(t, ev->sender) == E_HANDLED)) {
 		return E_HANDLED;
@@ -403,19 +729,128 @@ int emtile_event(EMTILE *t, struct emui_event *ev)
 }
 
 // -----------------------------------------------------------------------
-EMTILE * emtile(EMTILE *parent, struct emtile_drv *drv, int x, int y, int w, int h, int mt, int mb, int ml, int mr, char *name, int properties)
+EMTILE * _emtile_alloc(EMTILE *parent)
 {
-	EMTILE *t = calloc(1, sizeof(EMTILE));
-	if (!t) return NULL;
+	EMTILE *t;
+	EMARENA *arena = NULL;
+
+	if (parent) {
+		arena = parent->subtree_arena ? parent->subtree_arena : parent->arena;
+	}
 
+	if (arena) {
+		t = emarena_alloc(arena, sizeof(EMTILE));
+	} else {
+		if (!tile_slab) {
+			tile_slab = emslab(sizeof(EMTILE));
+			if (!tile_slab) return NULL;
+		}
+		t = emslab_alloc(tile_slab);
+	}
+
+	if (t) {
+		t->arena = arena;
+	}
+
+	return t;
+}
+
+// -----------------------------------------------------------------------
+static void _emtile_free(EMTILE *t)
+{
+	emui_name_release(t->name);
+
+	// arena memory goes away with the arena
+	if (t->arena) return;
+
+	emslab_free(tile_slab, t);
+}
+
+// -----------------------------------------------------------------------
+void _emtile_allocators_destroy()
+{
+	free(del_queue);
+	del_queue = NULL;
+	del_count = del_size = 0;
+	emslab_delete(tile_slab);
+	tile_slab = NULL;
+	for (int i=0 ; i<PRIV_SLAB_CLASSES ; i++) {
+		emslab_delete(priv_slabs[i]);
+		priv_slabs[i] = NULL;
+	}
+}
+
+// -----------------------------------------------------------------------
+void * emtile_priv_alloc(EMTILE *t, size_t size)
+{
+	int class = (size + PRIV_SLAB_GRAIN - 1) / PRIV_SLAB_GRAIN - 1;
+
+	t->priv_size = size;
+
+	if (t->arena) {
+		return emarena_alloc(t->arena, size);
+	}
+
+	// too big for a slab
+	if ((class < 0) || (class >= PRIV_SLAB_CLASSES)) {
+		return calloc(1, size);
+	}
+
+	if (!priv_slabs[class]) {
+		priv_slabs[class] = emslab((class + 1) * PRIV_SLAB_GRAIN);
+		if (!priv_slabs[class]) return NULL;
+	}
+
+	return emslab_alloc(priv_slabs[class]);
+}
+
+// -----------------------------------------------------------------------
+void emtile_priv_free(EMTILE *t)
+{
+	int class = (t->priv_size + PRIV_SLAB_GRAIN - 1) / PRIV_SLAB_GRAIN - 1;
+
+	if (!t->priv_data || t->arena) {
+		// nothing to free, or freed with the arena
+	} else if ((class < 0) || (class >= PRIV_SLAB_CLASSES)) {
+		free(t->priv_data);
+	} else {
+		emslab_free(priv_slabs[class], t->priv_data);
+	}
+
+	t->priv_data = NULL;
+	t->priv_size = 0;
+}
+
+// -----------------------------------------------------------------------
+int emtile_set_arena(EMTILE *t, size_t chunk_size)
+{
+	// children already allocated elsewhere
+	if (t->ch_first || t->subtree_arena) {
+		return E_CONFLICT;
+	}
+
+	t->subtree_arena = emarena(chunk_size);
+	if (!t->subtree_arena) {
+		return E_ALLOC;
+	}
+
+	return E_OK;
+}
+
+// -----------------------------------------------------------------------
+EMTILE * emtile(EMTILE *parent, struct emtile_drv *drv, int x, int y, int w, int h, int mt, int mb, int ml, int mr, char *name, int properties)
+{
 	if (!(parent->properties & P_CONTAINER)) {
 		return NULL;
 	}
 
+	EMTILE *t = _emtile_alloc(parent);
+	if (!t) return NULL;
+
 	if (name) {
-		t->name = strdup(name);
+		t->name = emui_name_intern(name);
 		if (!t->name) {
-			free(t);
+			_emtile_free(t);
 			return NULL;
 		}
 	}
@@ -442,13 +877,28 @@ EMTILE * emtile(EMTILE *parent, struct emtile_drv *drv, int x, int y, int w, int
 
 	emtile_child_append(parent, t);
 	emui_focus_group_add(parent, t);
-	emtile_fit(t);
+	emui_path_add(t);
+	if (!fit_deferred) {
+		emtile_fit(t);
+	}
+
+	// parent's children layout needs to be updated
+	parent->geometry_changed = 1;
 
 	EDBG(t, 0, "Added tile");
 
 	return t;
 }
 
+// -----------------------------------------------------------------------
+int _emtile_defer_fit(int defer)
+{
+	// new tiles are laid out when the outermost batch is committed
+	fit_deferred += defer ? 1 : -1;
+
+	return fit_deferred;
+}
+
 // -----------------------------------------------------------------------
 void emtile_set_geometry_parent(EMTILE *t, EMTILE *pg, int geom_type)
 {
@@ -468,9 +918,16 @@ void emtile_set_float_parent(EMTILE *t, EMTILE *p)
 }
 
 // -----------------------------------------------------------------------
-void emtile_set_focus_key(EMTILE *t, int key)
+void emtile_set_layer(EMTILE *t, int layer)
 {
-	t->key = key;
+	t->layer = layer;
+	emui_compose_track(t);
+}
+
+// -----------------------------------------------------------------------
+int emtile_set_focus_key(EMTILE *t, int key)
+{
+	return emui_focus_key_set(t, key);
 }
 
 // -----------------------------------------------------------------------
@@ -489,6 +946,7 @@ void emtile_set_change_handler(EMTILE *t, emui_int_f handler)
 void emtile_set_key_handler(EMTILE *t, emui_int_f_int handler)
 {
 	t->key_handler = handler;
+	emui_dispatch_invalidate();
 }
 
 // -----------------------------------------------------------------------
@@ -499,6 +957,7 @@ int emtile_set_properties(EMTILE *t, unsigned properties)
 	}
 
 	t->properties |= properties;
+	emtile_geometry_changed(t);
 
 	return E_OK;
 }
@@ -511,18 +970,24 @@ int emtile_clear_properties(EMTILE *t, unsigned properties)
 	}
 
 	t->properties &= ~properties;
+	emtile_geometry_changed(t);
 
 	return E_OK;
 }
 // -----------------------------------------------------------------------
 int emtile_set_name(EMTILE *t, char *name)
 {
-	free(t->name);
-	t->name = strdup(name);
-	if (!t->name) {
+	char *iname = emui_name_intern(name);
+	if (!iname) {
 		return E_ALLOC;
 	}
 
+	emui_name_release(t->name);
+	t->name = iname;
+
+	// tile is now at a different path (and so are its descendants)
+	emui_path_rename(t);
+
 	return E_OK;
 }
 
@@ -536,6 +1001,7 @@ void emtile_set_style(EMTILE *t, int style)
 static void emtile_child_append(EMTILE *parent, EMTILE *t)
 {
 	t->parent = parent;
+	t->depth = parent->depth + 1;
 	t->ch_prev = parent->ch_last;
 	if (parent->ch_last) {
 		parent->ch_last->ch_next = t;
@@ -543,6 +1009,8 @@ static void emtile_child_append(EMTILE *parent, EMTILE *t)
 		parent->ch_first = t;
 	}
 	parent->ch_last = t;
+
+	emui_tiletab_invalidate();
 }
 
 // -----------------------------------------------------------------------
@@ -562,20 +1030,64 @@ static void emtile_child_unlink(EMTILE *t)
 	if (t == t->parent->ch_last) {
 		t->parent->ch_last = t->ch_prev;
 	}
+
+	// let the container forget about the child
+	if (t->parent->drv->child_removed) {
+		t->parent->drv->child_removed(t->parent, t);
+	}
+
+	emui_tiletab_invalidate();
 }
 
 // -----------------------------------------------------------------------
 void emtile_delete(EMTILE *t)
 {
+	if (t->properties & P_DELETED) return;
+
+	// make room first: tile that is marked, but not queued, would never go away.
+	// It can't be deleted right away either, it may be on the path of the event
+	// being handled. Left unmarked, it can be deleted again later.
+	if (del_count >= del_size) {
+		int size = del_size ? del_size * 2 : 16;
+		EMTILE **q = realloc(del_queue, size * sizeof(EMTILE *));
+		if (!q) {
+			EDBG(t, 0, "Cannot queue tile for deletion");
+			return;
+		}
+		del_queue = q;
+		del_size = size;
+	}
+
 	EDBG(t, 0, "Tile marked for deletion");
 	t->properties |= P_DELETED;
+	emui_tiletab_update(t);
+
+	del_queue[del_count++] = t;
 }
 
 // -----------------------------------------------------------------------
-void _emtile_really_delete(EMTILE *t)
+static int emtile_deleted_ancestor(EMTILE *t)
 {
-	if (!t) return;
+	for (t=t->parent ; t ; t=t->parent) {
+		if (t->properties & P_DELETED) return 1;
+	}
+
+	return 0;
+}
+
+// -----------------------------------------------------------------------
+static void emtile_subtree_mark(EMTILE *t)
+{
+	t->properties |= P_DELETED;
+
+	for (EMTILE *ch=t->ch_first ; ch ; ch=ch->ch_next) {
+		emtile_subtree_mark(ch);
+	}
+}
 
+// -----------------------------------------------------------------------
+static void emtile_subtree_delete(EMTILE *t)
+{
 	EDBG(t, 0, "Physically deleting tile");
 
 	// delete all children first
@@ -583,34 +1095,97 @@ void _emtile_really_delete(EMTILE *t)
 	EMTILE *ch = t->ch_first;
 	while (ch) {
 		next_ch = ch->ch_next;
-		_emtile_really_delete(ch);
+		emtile_subtree_delete(ch);
 		ch = next_ch;
 	}
 
-	// remove from focus path
-	if (t->parent && (t->parent->focus == t)) {
-		t->parent->focus = NULL;
+	// only the subtree root needs to be detached from the rest of the tree,
+	// links between tiles within the subtree go away with the tiles
+	if (!t->parent || !(t->parent->properties & P_DELETED)) {
+		// remove from focus path
+		if (t->parent && (t->parent->focus == t)) {
+			t->parent->focus = NULL;
+		}
+		// remove the tile from parent's child list
+		emtile_child_unlink(t);
+		if (t->parent) {
+			t->parent->geometry_changed = 1;
+		}
 	}
 
-	// remove from focus group
-	emui_focus_group_unlink(t);
+	// remove from focus group (unless whole group is deleted)
+	if (t->fg && !(t->fg->properties & P_DELETED)) {
+		emui_focus_group_unlink(t);
+	}
+	emui_fgindex_delete(t);
+	emui_focus_keys_drop(t);
 
-	// remove from focus stack
-	emui_focus_stack_delete_tile(t);
+	// remove from the hit map and path index
+	emui_hitmap_remove(t);
+	emui_path_remove(t);
+	emui_compose_forget(t);
 
-	// remove the tile from parent's child list
-	emtile_child_unlink(t);
+	// drop connected handlers
+	emui_disconnect_all(t);
 
 	// delete the tile itself
-	delwin(t->ncwin);
-	free(t->name);
+	if (t->parent) {
+		emui_winpool_put(t->ncwin);
+	} else {
+		delwin(t->ncwin);
+	}
 	if (t->drv->destroy_priv_data) t->drv->destroy_priv_data(t);
-	free(t);
+	EMARENA *subtree_arena = t->subtree_arena;
+	_emtile_free(t);
+
+	// all descendants are gone, release their memory at once
+	emarena_delete(subtree_arena);
+}
+
+// -----------------------------------------------------------------------
+void _emtile_really_delete(EMTILE *t)
+{
+	if (!t) return;
+
+	emtile_subtree_mark(t);
+	emui_focus_stack_purge();
+	emtile_subtree_delete(t);
 
 	// refocus (there may be a deleted tile on focus path)
 	emui_focus_refocus();
 }
 
+// -----------------------------------------------------------------------
+int emtile_delete_queued()
+{
+	int count = 0;
+
+	if (!del_count) return 0;
+
+	// tiles within subtrees that are being deleted go away with them
+	for (int i=0 ; i<del_count ; i++) {
+		if (!emtile_deleted_ancestor(del_queue[i])) {
+			del_queue[count++] = del_queue[i];
+		}
+	}
+
+	// mark everything first, so the focus stack is purged in one sweep
+	for (int i=0 ; i<count ; i++) {
+		emtile_subtree_mark(del_queue[i]);
+	}
+	emui_focus_stack_purge();
+
+	for (int i=0 ; i<count ; i++) {
+		emtile_subtree_delete(del_queue[i]);
+	}
+	del_count = 0;
+
+	// refocus once (there may have been deleted tiles on focus path)
+	emui_focus_refocus();
+
+	return count;
+}
+
 // -----------------------------------------------------------------------
 void emtile_set_ptr(EMTILE *t, void *ptr)
 {
@@ -630,12 +1205,15 @@ void emtile_set_margins(EMTILE *t, int mt, int mb, int ml, int mr)
 	t->ml = ml;
 	t->mt = mt;
 	t->mb = mb;
+	emtile_geometry_changed(t);
 }
 
 // -----------------------------------------------------------------------
 void emtile_geometry_changed(EMTILE *t)
 {
 	t->geometry_changed = 1;
+	emui_lcache_invalidate();
+	emui_tiletab_update(t);
 	if (t->properties & P_GEOM_FORCED) {
 		emtile_geometry_changed(t->parent);
 	}
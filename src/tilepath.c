@@ -0,0 +1,318 @@
+//  Copyright (c) 2015 Jakub Filipowicz <jakubf@gmail.com>
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc.,
+//  51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+
+#include "dbg.h"
+#include "tile.h"
+#include "tilepath.h"
+
+// Tile names are interned: all tiles named the same share one
+// reference-counted copy of the name.
+//
+// Every tile (except for the root) is also indexed by its path: names
+// of all its ancestors below the root and its own name, separated
+// by '/', eg. "Debugger/Memory/Grid". Paths are never stored. Instead,
+// path hash is built incrementally from parent's hash and tile's name,
+// and a path is compared against the tile by walking up the tree.
+//
+// Tiles with the same path hash form a group: a doubly linked list
+// in the order of indexing, so that removing any tile takes constant time.
+// Buckets hold only group heads, so looking up a path doesn't go through
+// all the tiles that share some other path (eg. list rows).
+// If more tiles share a path, the one indexed first is found.
+
+#define NAME_BUCKETS 256
+#define PATH_BUCKETS_MIN 256
+
+struct name_item {
+	struct name_item *next;
+	unsigned hash;
+	int refs;
+	char str[];
+};
+
+static struct name_item *names[NAME_BUCKETS];
+
+static EMTILE **paths;
+static unsigned path_buckets;
+static unsigned path_count;		// number of groups
+
+// -----------------------------------------------------------------------
+static unsigned _hash(unsigned h, const char *s, size_t len)
+{
+	// FNV-1a
+	for (size_t i=0 ; i<len ; i++) {
+		h ^= (unsigned char) s[i];
+		h *= 16777619u;
+	}
+
+	return h;
+}
+
+#define HASH_INIT 2166136261u
+
+// -----------------------------------------------------------------------
+char * emui_name_intern(char *name)
+{
+	size_t len = strlen(name);
+	unsigned hash = _hash(HASH_INIT, name, len);
+	struct name_item **ni = &names[hash % NAME_BUCKETS];
+
+	while (*ni) {
+		if (((*ni)->hash == hash) && !strcmp((*ni)->str, name)) {
+			(*ni)->refs++;
+			return (*ni)->str;
+		}
+		ni = &(*ni)->next;
+	}
+
+	struct name_item *nni = malloc(sizeof(struct name_item) + len + 1);
+	if (!nni) return NULL;
+
+	nni->next = NULL;
+	nni->hash = hash;
+	nni->refs = 1;
+	memcpy(nni->str, name, len + 1);
+	*ni = nni;
+
+	return nni->str;
+}
+
+// -----------------------------------------------------------------------
+void emui_name_release(char *name)
+{
+	if (!name) return;
+
+	struct name_item *item = (struct name_item *) (name - offsetof(struct name_item, str));
+
+	if (--item->refs > 0) return;
+
+	struct name_item **ni = &names[item->hash % NAME_BUCKETS];
+	while (*ni != item) {
+		ni = &(*ni)->next;
+	}
+	*ni = item->next;
+	free(item);
+}
+
+// -----------------------------------------------------------------------
+static unsigned _path_hash(EMTILE *t)
+{
+	unsigned h = HASH_INIT;
+
+	// tiles directly below the root start the path
+	if (t->parent->parent) {
+		h = _hash(t->parent->path_hash, "/", 1);
+	}
+
+	return t->name ? _hash(h, t->name, strlen(t->name)) : h;
+}
+
+// -----------------------------------------------------------------------
+static int _path_grow()
+{
+	unsigned size = path_buckets ? path_buckets * 2 : PATH_BUCKETS_MIN;
+	EMTILE **np = calloc(size, sizeof(EMTILE *));
+	if (!np) return E_ALLOC;
+
+	// rehash groups, tiles within them stay in order
+	for (unsigned i=0 ; i<path_buckets ; i++) {
+		EMTILE *g = paths[i];
+		while (g) {
+			EMTILE *next = g->path_group;
+			unsigned b = g->path_hash % size;
+			g->path_group = np[b];
+			np[b] = g;
+			g = next;
+		}
+	}
+
+	free(paths);
+	paths = np;
+	path_buckets = size;
+
+	return E_OK;
+}
+
+// -----------------------------------------------------------------------
+static EMTILE ** _path_group(unsigned hash)
+{
+	EMTILE **g = &paths[hash % path_buckets];
+
+	while (*g && ((*g)->path_hash != hash)) {
+		g = &(*g)->path_group;
+	}
+
+	return g;
+}
+
+// -----------------------------------------------------------------------
+static void _path_link(EMTILE *t)
+{
+	t->path_hash = _path_hash(t);
+	t->path_next = NULL;
+	t->path_group = NULL;
+
+	EMTILE **g = _path_group(t->path_hash);
+	EMTILE *head = *g;
+
+	if (head) {
+		// append to the group
+		t->path_prev = head->path_prev;
+		head->path_prev->path_next = t;
+		head->path_prev = t;
+	} else {
+		// start a new group
+		t->path_prev = t;
+		*g = t;
+		path_count++;
+	}
+}
+
+// -----------------------------------------------------------------------
+static void _path_unlink(EMTILE *t)
+{
+	// not indexed
+	if (!t->path_prev) return;
+
+	EMTILE **g = _path_group(t->path_hash);
+	EMTILE *head = *g;
+
+	if (head == t) {
+		EMTILE *next = t->path_next;
+		if (next) {
+			// next tile becomes the group head
+			next->path_prev = t->path_prev;
+			next->path_group = t->path_group;
+			*g = next;
+		} else {
+			*g = t->path_group;
+			path_count--;
+		}
+	} else {
+		t->path_prev->path_next = t->path_next;
+		if (t->path_next) {
+			t->path_next->path_prev = t->path_prev;
+		} else {
+			head->path_prev = t->path_prev;
+		}
+	}
+
+	t->path_next = t->path_prev = t->path_group = NULL;
+}
+
+// -----------------------------------------------------------------------
+int emui_path_add(EMTILE *t)
+{
+	if (!t->parent) return E_OK;
+
+	if ((path_count >= path_buckets) && (_path_grow() != E_OK)) {
+		if (!path_buckets) return E_ALLOC;
+	}
+
+	_path_link(t);
+
+	return E_OK;
+}
+
+// -----------------------------------------------------------------------
+void emui_path_remove(EMTILE *t)
+{
+	if (!t->parent || !paths) return;
+
+	_path_unlink(t);
+}
+
+// -----------------------------------------------------------------------
+static void _path_relink(EMTILE *t)
+{
+	_path_unlink(t);
+	_path_link(t);
+
+	for (EMTILE *ch=t->ch_first ; ch ; ch=ch->ch_next) {
+		_path_relink(ch);
+	}
+}
+
+// -----------------------------------------------------------------------
+void emui_path_rename(EMTILE *t)
+{
+	if (!t->parent || !paths) return;
+
+	// paths of all descendants change too
+	_path_relink(t);
+}
+
+// -----------------------------------------------------------------------
+static int _path_matches(EMTILE *t, const char *path, size_t len)
+{
+	const char *end = path + len;
+
+	while (t->parent) {
+		const char *name = t->name ? t->name : "";
+		size_t nlen = strlen(name);
+		const char *begin = end - nlen;
+
+		if ((begin < path) || memcmp(begin, name, nlen)) {
+			return 0;
+		}
+
+		t = t->parent;
+
+		if (t->parent) {
+			// there needs to be a separator before the name
+			if ((begin == path) || (begin[-1] != '/')) return 0;
+			end = begin - 1;
+		} else {
+			// ...and nothing before the top-level name
+			return begin == path;
+		}
+	}
+
+	return 0;
+}
+
+// -----------------------------------------------------------------------
+EMTILE * emtile_find(char *path)
+{
+	if (!path || !paths) return NULL;
+
+	size_t len = strlen(path);
+	unsigned hash = _hash(HASH_INIT, path, len);
+
+	// tiles in the group may still differ in path, if hashes collide
+	for (EMTILE *t=*_path_group(hash) ; t ; t=t->path_next) {
+		if (!(t->properties & P_DELETED) && _path_matches(t, path, len)) {
+			return t;
+		}
+	}
+
+	return NULL;
+}
+
+// -----------------------------------------------------------------------
+void emui_path_destroy()
+{
+	free(paths);
+	paths = NULL;
+	path_buckets = path_count = 0;
+}
+
+// vim: tabstop=4 shiftwidth=4 autoindent
@@ -0,0 +1,192 @@
+//  Copyright (c) 2015 Jakub Filipowicz <jakubf@gmail.com>
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc.,
+//  51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+
+
+#include <stdlib.h>
+
+#include "dbg.h"
+#include "tile.h"
+#include "tiletab.h"
+#include "lcache.h"
+
+// Tile table mirrors tile properties and the "needs refit" flag
+// in dense arrays, one row per tile, in tree (pre-)order. Subtree of a tile
+// is a contiguous range of rows: [t->tt_idx, tt_end[t->tt_idx]).
+// That's enough for the draw pass to tell with one linear scan if
+// a hidden subtree can be skipped, and gives the layout cache and pool
+// a stable tile order.
+//
+// Geometry stays in the tiles: fit runs driver code that reads and writes
+// it there, and hit-testing goes through the bucketed hit map, which
+// only looks at tiles near the pointer.
+//
+// Table is rebuilt lazily (with the next emui_tiletab_sync()) after
+// any change to the tree structure. Rows are refreshed whenever
+// a tile is fitted, marked as changed or deleted.
+// Until the table is rebuilt all queries return conservative answers.
+
+static EMTILE **tt_tile;
+static int *tt_end;
+static unsigned *tt_props;
+static unsigned char *tt_dirty;
+
+static int tt_count;
+static int tt_size;
+static int tt_valid;
+
+// -----------------------------------------------------------------------
+void emui_tiletab_invalidate()
+{
+	tt_valid = 0;
+	// tree structure has changed, cached layouts are no good
+	emui_lcache_invalidate();
+}
+
+// -----------------------------------------------------------------------
+static int _tt_grow(int size)
+{
+	void *p;
+
+	// on failure arrays that got reallocated are kept, they're just bigger
+#define TT_REALLOC(a) \
+	p = realloc(a, size * sizeof(*(a))); \
+	if (!p) return E_ALLOC; \
+	a = p;
+
+	TT_REALLOC(tt_tile);
+	TT_REALLOC(tt_end);
+	TT_REALLOC(tt_props);
+	TT_REALLOC(tt_dirty);
+
+#undef TT_REALLOC
+
+	tt_size = size;
+
+	return E_OK;
+}
+
+// -----------------------------------------------------------------------
+static void _tt_row(int idx)
+{
+	EMTILE *t = tt_tile[idx];
+
+	tt_props[idx] = t->properties;
+	tt_dirty[idx] = t->geometry_changed ? 1 : 0;
+}
+
+// -----------------------------------------------------------------------
+static int _tt_add(EMTILE *t)
+{
+	if (tt_count >= tt_size) {
+		if (_tt_grow(tt_size ? tt_size * 2 : 256) != E_OK) {
+			return E_ALLOC;
+		}
+	}
+
+	int idx = tt_count++;
+
+	t->tt_idx = idx;
+	tt_tile[idx] = t;
+	_tt_row(idx);
+
+	EMTILE *ch = t->ch_first;
+	while (ch) {
+		if (_tt_add(ch) != E_OK) {
+			return E_ALLOC;
+		}
+		ch = ch->ch_next;
+	}
+
+	tt_end[idx] = tt_count;
+
+	return E_OK;
+}
+
+// -----------------------------------------------------------------------
+int emui_tiletab_sync(EMTILE *root)
+{
+	if (tt_valid) return E_OK;
+
+	tt_count = 0;
+	if (_tt_add(root) != E_OK) {
+		return E_ALLOC;
+	}
+	tt_valid = 1;
+
+	EDBG(root, 1, "tile table rebuilt: %i rows", tt_count);
+
+	return E_OK;
+}
+
+// -----------------------------------------------------------------------
+static int _tt_has(EMTILE *t)
+{
+	return tt_valid && (t->tt_idx < tt_count) && (tt_tile[t->tt_idx] == t);
+}
+
+// -----------------------------------------------------------------------
+void emui_tiletab_update(EMTILE *t)
+{
+	if (_tt_has(t)) {
+		_tt_row(t->tt_idx);
+	}
+}
+
+// -----------------------------------------------------------------------
+int emui_tiletab_subtree_idle(EMTILE *t)
+{
+	// don't know, better visit the subtree
+	if (!_tt_has(t)) return 0;
+
+	// subtree is idle when all its tiles are hidden, not floating,
+	// not deleted and don't need a refit
+	unsigned busy = 0;
+	for (int k=t->tt_idx ; k<tt_end[t->tt_idx] ; k++) {
+		busy |= ((tt_props[k] ^ P_HIDDEN) & (P_HIDDEN | P_FLOAT | P_DELETED)) | tt_dirty[k];
+	}
+
+	return !busy;
+}
+
+// -----------------------------------------------------------------------
+int emui_tiletab_count()
+{
+	return tt_valid ? tt_count : 0;
+}
+
+// -----------------------------------------------------------------------
+EMTILE * emui_tiletab_tile(int idx)
+{
+	return tt_tile[idx];
+}
+
+// -----------------------------------------------------------------------
+void emui_tiletab_destroy()
+{
+	free(tt_tile);
+	free(tt_end);
+	free(tt_props);
+	free(tt_dirty);
+	tt_tile = NULL;
+	tt_end = NULL;
+	tt_props = NULL;
+	tt_dirty = NULL;
+	tt_count = tt_size = 0;
+	tt_valid = 0;
+}
+
+// vim: tabstop=4 shiftwidth=4 autoindent
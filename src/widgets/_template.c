@@ -48,7 +48,7 @@ int emui_W_NAME_event_handler(EMTILE *t, struct emui_event *ev)
 // -----------------------------------------------------------------------
 void emui_W_NAME_destroy_priv_data(EMTILE *t)
 {
-	free(t->priv_data);
+	emtile_priv_free(t);
 }
 
 // -----------------------------------------------------------------------
@@ -67,7 +67,7 @@ EMTILE * emui_W_NAME(EMTILE *parent, int x, int y, int w, int h)
 
 	t = emtile(parent, -1, &emui_W_NAME_drv, F_WIDGET, x, y, w, h, 0, 0, 0, 0, "_W_NAME_", P_INTERACTIVE);
 
-	t->priv_data = calloc(1, sizeof(struct W_NAME));
+	t->priv_data = emtile_priv_alloc(t, sizeof(struct W_NAME));
 	struct W_NAME *d = t->priv_data;
 
 	return t;
@@ -42,7 +42,7 @@ void emui_label_destroy_priv_data(EMTILE *t)
 {
 	struct label *d = t->priv_data;
 	emtext_delete(d->txt);
-	free(d);
+	emtile_priv_free(t);
 }
 
 // -----------------------------------------------------------------------
@@ -65,9 +65,9 @@ EMTILE * emui_label(EMTILE *parent, int x, int y, int w, int style, char *str)
 {
 	EMTILE *t;
 
-	t = emtile(parent, &emui_label_drv, x, y, w, 1, 0, 0, 0, 0, "Label", P_NONE);
+	t = emtile(parent, &emui_label_drv, x, y, w, 1, 0, 0, 0, 0, "Label", P_SHARED_CANVAS);
 
-	t->priv_data = calloc(1, sizeof(struct label));
+	t->priv_data = emtile_priv_alloc(t, sizeof(struct label));
 	struct label *d = t->priv_data;
 	d->txt = emtext();
 	emtext_append_str(d->txt, style, str);
@@ -42,7 +42,7 @@ void emui_line_draw(EMTILE *t)
 // -----------------------------------------------------------------------
 void emui_line_destroy_priv_data(EMTILE *t)
 {
-	free(t->priv_data);
+	emtile_priv_free(t);
 }
 
 // -----------------------------------------------------------------------
@@ -69,9 +69,9 @@ EMTILE * emui_line(EMTILE *parent, int align, int x, int y, int len)
 		return NULL;
 	}
 
-	t = emtile(parent, &emui_line_drv, x, y, w, h, 0, 0, 0, 0, "Line", P_NONE);
+	t = emtile(parent, &emui_line_drv, x, y, w, h, 0, 0, 0, 0, "Line", P_SHARED_CANVAS);
 
-	t->priv_data = calloc(1, sizeof(struct line));
+	t->priv_data = emtile_priv_alloc(t, sizeof(struct line));
 	struct line *d = t->priv_data;
 	d->align = align;
 
@@ -230,6 +230,48 @@ static int le_handle_edit(EMTILE *t, struct emui_event *ev)
 	return E_HANDLED;
 }
 
+// -----------------------------------------------------------------------
+// insert (or overwrite with) pasted text in one go
+static int le_handle_paste(EMTILE *t, struct emui_event *ev)
+{
+	struct lineedit *le = t->priv_data;
+	int len = strlen(le->editbuf);
+	char *src = ev->data;
+
+	if (!src) return E_HANDLED;
+
+	if (le->mode == M_OVR) {
+		while (*src && (le->pos < le->maxlen)) {
+			if (le_char_valid(le->type, (unsigned char) *src, le->pos)) {
+				le->editbuf[le->pos] = *src;
+				if (le->pos >= len) {
+					len = le->pos + 1;
+				}
+				// cursor stays on the last character, as with typing
+				if (le->pos >= le->maxlen - 1) break;
+				le->pos++;
+			}
+			src++;
+		}
+		le->editbuf[len] = '\0';
+	} else {
+		char *tail = strdup(le->editbuf + le->pos);
+		if (!tail) return E_HANDLED;
+		int room = le->maxlen - len;
+		while (*src && (room > 0)) {
+			if (le_char_valid(le->type, (unsigned char) *src, le->pos)) {
+				le->editbuf[le->pos++] = *src;
+				room--;
+			}
+			src++;
+		}
+		strcpy(le->editbuf + le->pos, tail);
+		free(tail);
+	}
+
+	return E_HANDLED;
+}
+
 // -----------------------------------------------------------------------
 int emui_lineedit_event_handler(EMTILE *t, struct emui_event *ev)
 {
@@ -241,6 +283,11 @@ int emui_lineedit_event_handler(EMTILE *t, struct emui_event *ev)
 		} else {
 			return le_handle_non_edit(t, ev);
 		}
+	} else if (ev->type == EV_PASTE) {
+		if (!le->in_edit) {
+			emui_lineedit_edit(t, 1);
+		}
+		return le_handle_paste(t, ev);
 	}
 
 	return E_UNHANDLED;
@@ -253,7 +300,7 @@ void emui_lineedit_destroy_priv_data(EMTILE *t)
 	curs_set(0);
 	free(le->buf);
 	free(le->editbuf);
-	free(le);
+	emtile_priv_free(t);
 }
 
 // -----------------------------------------------------------------------
@@ -269,10 +316,10 @@ EMTILE * emui_lineedit(EMTILE *parent, int x, int y, int w, int maxlen, int type
 {
 	EMTILE *t;
 
-	t = emtile(parent, &emui_lineedit_drv, x, y, w, 1, 0, 0, 0, 0, "LineEdit", P_INTERACTIVE);
+	t = emtile(parent, &emui_lineedit_drv, x, y, w, 1, 0, 0, 0, 0, "LineEdit", P_INTERACTIVE | P_SHARED_CANVAS);
 	emtile_set_style(t, S_EDIT_NN);
 
-	t->priv_data = calloc(1, sizeof(struct lineedit));
+	t->priv_data = emtile_priv_alloc(t, sizeof(struct lineedit));
 
 	struct lineedit *le = t->priv_data;
 
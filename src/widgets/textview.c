@@ -76,7 +76,7 @@ void emui_textview_destroy_priv_data(EMTILE *t)
 {
 	struct textview *d = t->priv_data;
 	emtext_delete(d->txt);
-	free(t->priv_data);
+	emtile_priv_free(t);
 }
 
 // -----------------------------------------------------------------------
@@ -94,7 +94,7 @@ EMTILE * emui_textview(EMTILE *parent, int x, int y, int w, int h)
 
 	t = emtile(parent, &emui_textview_drv, x, y, w, h, 0, 0, 0, 0, "TextView", P_INTERACTIVE);
 
-	t->priv_data = calloc(1, sizeof(struct textview));
+	t->priv_data = emtile_priv_alloc(t, sizeof(struct textview));
 
 	struct textview *d = t->priv_data;
 	d->txt = emtext();
@@ -0,0 +1,153 @@
+//  Copyright (c) 2015 Jakub Filipowicz <jakubf@gmail.com>
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc.,
+//  51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <ncurses.h>
+
+#include "tile.h"
+#include "winpool.h"
+
+// Windows of tiles that got hidden (or deleted) are kept in a pool
+// instead of being deleted, bucketed by window size. Tiles that need
+// a window take one of the same size if there is any, otherwise any
+// pooled window is resized, and only if the pool is empty a new window
+// is created. Pool size is limited, excess windows are deleted.
+
+#define WINPOOL_BUCKETS 64
+#define WINPOOL_MAX 128
+
+struct winpool_bucket {
+	WINDOW **win;
+	int count;
+	int size;
+};
+
+static struct winpool_bucket pool[WINPOOL_BUCKETS];
+static int pool_count;
+
+// -----------------------------------------------------------------------
+static struct winpool_bucket * _bucket(int h, int w)
+{
+	uint32_t k = (uint32_t) h * 0x9e3779b1u ^ (uint32_t) w * 0x85ebca6bu;
+	k ^= k >> 16;
+
+	return pool + (k % WINPOOL_BUCKETS);
+}
+
+// -----------------------------------------------------------------------
+static WINDOW * _take(struct winpool_bucket *b, int i)
+{
+	WINDOW *win = b->win[i];
+
+	b->win[i] = b->win[--b->count];
+	pool_count--;
+
+	return win;
+}
+
+// -----------------------------------------------------------------------
+static WINDOW * _find(int h, int w)
+{
+	struct winpool_bucket *b = _bucket(h, w);
+	int wh, ww;
+
+	// window of the same size
+	for (int i=b->count-1 ; i>=0 ; i--) {
+		getmaxyx(b->win[i], wh, ww);
+		if ((wh == h) && (ww == w)) {
+			return _take(b, i);
+		}
+	}
+
+	// any window, it'll be resized
+	if (pool_count > 0) {
+		for (b=pool ; b<pool+WINPOOL_BUCKETS ; b++) {
+			if (b->count > 0) {
+				WINDOW *win = _take(b, b->count-1);
+				wresize(win, h, w);
+				return win;
+			}
+		}
+	}
+
+	return NULL;
+}
+
+// -----------------------------------------------------------------------
+WINDOW * emui_winpool_get(int h, int w, int y, int x)
+{
+	WINDOW *win = _find(h, w);
+
+	if (!win) {
+		return newwin(h, w, y, x);
+	}
+
+	if (mvwin(win, y, x) == ERR) {
+		delwin(win);
+		return newwin(h, w, y, x);
+	}
+	werase(win);
+
+	return win;
+}
+
+// -----------------------------------------------------------------------
+void emui_winpool_put(WINDOW *win)
+{
+	if (!win) return;
+
+	int h, w;
+	getmaxyx(win, h, w);
+	struct winpool_bucket *b = _bucket(h, w);
+
+	if (pool_count >= WINPOOL_MAX) {
+		delwin(win);
+		return;
+	}
+
+	if (b->count >= b->size) {
+		int size = b->size ? b->size * 2 : 4;
+		WINDOW **nwin = realloc(b->win, size * sizeof(WINDOW *));
+		if (!nwin) {
+			delwin(win);
+			return;
+		}
+		b->win = nwin;
+		b->size = size;
+	}
+
+	b->win[b->count++] = win;
+	pool_count++;
+}
+
+// -----------------------------------------------------------------------
+void emui_winpool_destroy()
+{
+	for (int i=0 ; i<WINPOOL_BUCKETS ; i++) {
+		for (int j=0 ; j<pool[i].count ; j++) {
+			delwin(pool[i].win[j]);
+		}
+		free(pool[i].win);
+		pool[i].win = NULL;
+		pool[i].count = pool[i].size = 0;
+	}
+	pool_count = 0;
+}
+
+// vim: tabstop=4 shiftwidth=4 autoindent